@@ -8,9 +8,51 @@
  *
  * INSTRUCTIONS:
  * The program is written on version: c++11
- * Run with an input file: "./a.out filename" (Eg: ./a.out input.txt)
+ * Build with "make", which also builds the solvers as the library libmaxsum.a (see maxsum/maxsum.h),
+ * and "make check" compares the engines with each other and with brute force.
+ * Run with an input file: "./maxsum-cli filename" (Eg: ./maxsum-cli input.txt)
  * Input file should only contain the numbers in a pyramid or orthogonal triangle form.
- * Run if you want to give input from terminal: "./a.out"
+ * Run if you want to give input from terminal: "./maxsum-cli"
+ * Choose the solver with "--engine=implicit" (default), "--engine=rolling" or "--engine=dag" (Eg: ./maxsum-cli --engine=dag input.txt)
+ * The rolling engine solves while reading and keeps only two levels in memory.
+ * The stream engine reads one level per line from a pipe, FIFO or stdin ("-" or no filename)
+ * and prints the answer once the last line arrives (Eg: producer | ./maxsum-cli --engine=stream).
+ * The other engines also read a whole pyramid from stdin with "-" as filename.
+ * Files are memory-mapped and scanned directly, "--reader=stream" uses ifstream instead.
+ * Primality is looked up in a sieve up to the largest number, at most "--sieve-limit=100000000".
+ * Paths go through numbers that are not prime, "--admit=composite", "--admit=divisible:K"
+ * or "--admit=range:LOW:HIGH" choose other numbers instead.
+ * Levels are relaxed with AVX2 if the CPU has it, "--kernel=scalar" forces the portable loop.
+ * Wide levels are split between threads with "--threads=N" (0 for one per core).
+ * Vertex numbers and sums are 32-bit by default, "--index-bits=64" and "--weight-bits=64"
+ * (or both with "--wide") are for pyramids beyond 46340 levels or sums beyond 2^31.
+ * A pyramid with too many levels for its vertex numbers is rejected with an error, but sums are
+ * not checked: they wrap around (Eg: 2000000000 + 2000000000 is -294967296 with 32-bit weights),
+ * and once they do the engines may disagree on the best sum.
+ * "--semiring=min-plus" finds the minimum sum, "--semiring=count" counts the paths (modulo 2^64)
+ * and "--semiring=bottleneck" finds the path whose smallest number is largest.
+ * "--semiring=max-count" also counts all paths and those with the maximum sum, exactly up to 2^128
+ * or modulo "--modulus=M".
+ * "--path" also prints the level and number of each cell on that path (not for "--semiring=count").
+ * It keeps a bit per number, with "--engine=rolling" and a file "--path=checkpoint" keeps
+ * about sqrt(N) levels of sums instead and reads the file three times (to count its levels,
+ * to solve it and to recover the path).
+ * "--top=K" prints the K best sums with their paths (implicit engine only).
+ * "--bench-updates=U" changes U random numbers one at a time, re-solving only the levels below each,
+ * and prints the time per update next to that of a full solve (implicit engine only). The sum printed
+ * is still that of the input, the updated pyramid is only checked against a full solve.
+ * If no path reaches the bottom-most level, the answer is that of the last reachable number.
+ * "--batch" solves many pyramids with the implicit engine: those of the input file or stdin separated
+ * by blank lines, or each file of a directory given as filename. It prints one line per pyramid,
+ * "<position or file name>\t<answer>" (see maxsum/batch.h), and the throughput to stderr.
+ * Pyramids are shared between "--workers=N" threads (0 for one per core) that steal from each
+ * other's queues, the lines stay in input order and the time each worker was busy is printed.
+ * "--lanes" solves up to 8 consecutive pyramids of the same height at once, each in its own
+ * vector lane, for batches of many tiny pyramids (only with "--batch", and not with "--path" or "--top").
+ * "--serve=SOCKET" keeps answering pyramids sent to that Unix domain socket with the other options
+ * (implicit engine only), on "--workers=N" threads (0 for one per core, see maxsum/server.h).
+ * "--load=SOCKET" sends the input file to such a server "--requests=N" times (10000) over
+ * "--connections=C" connections (4), "--binary" as 64-bit numbers, and prints requests/s and latencies.
  * 
  * METHOD:
  * At the top is an extra start (source) node that is connected to the top-most level of the pyramid.
@@ -19,283 +61,178 @@
  * At the end is a stop (destination) node.
  * The bottom-most nodes which are not prime numbers are connected to this stop node.
  * Weight of these edges are zero.
+ *
+ * The implicit engine solves the same problem without building the DAG:
+ * the parents of level i, number j are level i-1, numbers j-1 and j,
+ * so each level is relaxed from the sums of the level above.
  */
 
 #include <iostream> // cerr, cin, cout
-#include <climits> // INT_MAX
-#include <string> // string, getline
-#include <list> // STL List
-#include <stack> // STL Stack
-#include <fstream> // ifstream
-
-using namespace std;
-
-struct Edge {
-    int vertexNum;
-    int edgeWeight; // in negative
-
-    Edge (int vertexNum, int edgeWeight);
-    ~Edge () {}
-};
-
-Edge::Edge (int vertexNum, int edgeWeight) {
-    this->vertexNum = vertexNum;
-    this->edgeWeight = edgeWeight;
-}
-
-struct DAG {
-    int vertexAmount;   // count of vertices
-    list<Edge> *edgeList; // holds edges between non-prime numbers
-    bool * visited; // holds whether a vertex has been visited (for sorting)
-    stack<int> s;
+#include <cstdlib> // atoi, atoll, strtoull
+#include <string> // string
+#include <vector> // STL Vector
 
-    DAG(int edgeAmount);
-    ~DAG();
+#include "maxsum/batch.h"
+#include "maxsum/maxsum.h"
+#include "maxsum/server.h"
 
-    void topologicalSortRecursive(int v);
-    void addEdge(int source, int destination, int positiveWeight);
-    void maximumSum(); // topologicalSort()
-};
-  
-DAG::DAG(int vertexAmount) {
-    this->vertexAmount = vertexAmount;
-    this->edgeList = new list<Edge>[vertexAmount];
-}
-
-DAG::~DAG() {
-    delete [] edgeList;
-}
-
-void DAG::addEdge(int source, int destination, int positiveWeight)
-{
-    Edge newEdge(destination, -positiveWeight); // hold the negative
-    edgeList[source].push_back(newEdge); // put it to the edge list
-}
+using namespace std;
 
-void DAG::topologicalSortRecursive(int vertex)
-{
-    visited[vertex] = true;
-  
-    list<Edge>::iterator it;
-    for (it = this->edgeList[vertex].begin(); it != edgeList[vertex].end(); it++)
-    {
-        Edge edge = *it;
-        if ( visited[edge.vertexNum] == false) {
-            topologicalSortRecursive(edge.vertexNum);
-        }
+void printPath(const vector<maxsum::Cell>& path) {
+    if (path.empty() == true) {
+        cout << "Path does not exist." << endl;
+        return;
     }
-    s.push(vertex);
-}
-  
-void DAG::maximumSum()
-{
-    // Time Complexity: O(V + E) where V are Vertices and E are Edges
-    int *sum = new int[vertexAmount];
-  
-    // Mark all the vertices as not visited
-    this->visited = new bool[this->vertexAmount] { false };
-  
-    for (int i = 0; i < this->vertexAmount; i++) {
-        if (visited[i] == false) {
-            topologicalSortRecursive(i);
-        }
+    cout << "Path:";
+    for (size_t k = 0; k < path.size(); k++) {
+        cout << " (" << path[k].level << ", " << path[k].number << ")";
     }
+    cout << endl;
+}
 
-    delete [] this->visited;
-  
-    for (int i = 0; i < this->vertexAmount; i++) {
-        sum[i] = INT_MAX;
-    }
-    sum[0] = 0; // Initialize the sum to 0
-  
-    while (this->s.empty() == false)
-    {
-        int source = s.top(); // get source
-        s.pop(); // remove source from stack
-  
-        list<Edge>::iterator i;
-        if (sum[source] != INT_MAX)
-        {
-            for (i = this->edgeList[source].begin(); i != this->edgeList[source].end(); i++) {
-                if (sum[i->vertexNum] > sum[source] + i->edgeWeight) {
-                    sum[i->vertexNum] = sum[source] + i->edgeWeight;
-                }
-            }
-        }
-    }
+int main (int argc, char** argv) {
 
-    // print sum
-    for (int i = this->vertexAmount - 1; i >= 0; i--) {
-        if (sum[i] != INT_MAX) {
-            cout << "Maximum Sum: " << -sum[i] << endl;
-            delete [] sum;
-            return;
+    maxsum::Options options;
+    string serveSocket = ""; // --serve
+    string loadSocket = ""; // --load
+    int workers = 0;
+    long long requests = 10000;
+    int connections = 4;
+    bool binary = false;
+    bool batch = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 9, "--engine=") == 0) {
+            options.engine = arg.substr(9);
+        } else if (arg.compare(0, 9, "--reader=") == 0) {
+            options.reader = arg.substr(9);
+        } else if (arg.compare(0, 14, "--sieve-limit=") == 0) {
+            options.sieveLimit = atoi(arg.c_str() + 14);
+        } else if (arg.compare(0, 8, "--admit=") == 0) {
+            options.admit = arg.substr(8);
+        } else if (arg.compare(0, 9, "--kernel=") == 0) {
+            options.kernel = arg.substr(9);
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            options.threads = atoi(arg.c_str() + 10);
+        } else if (arg.compare(0, 13, "--index-bits=") == 0) {
+            options.indexBits = atoi(arg.c_str() + 13);
+        } else if (arg.compare(0, 14, "--weight-bits=") == 0) {
+            options.weightBits = atoi(arg.c_str() + 14);
+        } else if (arg.compare(0, 11, "--semiring=") == 0) {
+            options.semiring = arg.substr(11);
+        } else if (arg.compare("--path") == 0) {
+            options.path = "bits";
+        } else if (arg.compare(0, 16, "--bench-updates=") == 0) {
+            options.updates = atoll(arg.c_str() + 16);
+        } else if (arg.compare(0, 6, "--top=") == 0) {
+            options.top = atoll(arg.c_str() + 6);
+        } else if (arg.compare(0, 7, "--path=") == 0) {
+            options.path = arg.substr(7);
+        } else if (arg.compare(0, 10, "--modulus=") == 0) {
+            options.modulus = strtoull(arg.c_str() + 10, NULL, 10);
+        } else if (arg.compare(0, 8, "--serve=") == 0) {
+            serveSocket = arg.substr(8);
+        } else if (arg.compare(0, 10, "--workers=") == 0) {
+            workers = atoi(arg.c_str() + 10);
+        } else if (arg.compare(0, 7, "--load=") == 0) {
+            loadSocket = arg.substr(7);
+        } else if (arg.compare(0, 11, "--requests=") == 0) {
+            requests = atoll(arg.c_str() + 11);
+        } else if (arg.compare(0, 14, "--connections=") == 0) {
+            connections = atoi(arg.c_str() + 14);
+        } else if (arg.compare("--lanes") == 0) {
+            options.lanes = true;
+        } else if (arg.compare("--batch") == 0) {
+            batch = true;
+        } else if (arg.compare("--binary") == 0) {
+            binary = true;
+        } else if (arg.compare("--wide") == 0) {
+            options.indexBits = 64;
+            options.weightBits = 64;
+        } else {
+            options.filename = arg;
         }
     }
-    cout << "Maximum sum does not exist." << endl;
-    delete [] sum;
-    return;
-}
 
-bool isPrime(int num)
-{
-    // Time Complexity: O(sqrt(n))
-    if (num <= 1) {
-        return false;
-    }
-    if (num <= 3) {
-        return true;
+    string error = maxsum::validate(options);
+    if (error.compare("") != 0) {
+        cerr << "ERROR: " << error << endl;
+        return 1;
     }
 
-    if (num % 2 == 0 || num % 3 == 0) {
-        return false;
-    }
-
-    for (int i = 5; i * i <= num; i += 6) {
-        if (num % i == 0 || num % (i + 2) == 0) {
-            return false;
+    if (batch == true) {
+        ios_base::sync_with_stdio(false); // one line per pyramid
+        maxsum::BatchStats stats;
+        error = maxsum::solveBatch(options, workers, cin, cout, stats);
+        if (error.compare("") != 0) {
+            cerr << "ERROR: " << error << endl;
+            return 1;
+        }
+        cerr << "Batch: " << stats.pyramids << " pyramids in " << stats.seconds << " s, "
+             << stats.pyramids / stats.seconds << " pyramids/s, "
+             << stats.bytes / stats.seconds / 1e6 << " MB/s, " << stats.errors << " errors" << endl;
+        for (size_t w = 0; w < stats.workers.size(); w++) {
+            cerr << "Worker " << w + 1 << ": " << stats.workers[w].pyramids << " pyramids, "
+                 << stats.workers[w].stolen << " stolen, "
+                 << 100 * stats.workers[w].busySeconds / stats.seconds << "% busy" << endl;
         }
+        return stats.errors > 0 ? 1 : 0;
     }
 
-    return true;
-}
-
-void readInput(int N, DAG *& pyramid) {
-    int NSum = 0;
-    for (int i = 1; i <= N; i++) {
-        NSum += i;
-    }
-    pyramid = new DAG(NSum + 2);
-    
-    int num = 0;
-    cout << "Level 1, Number 1: ";
-    cin >> num;
-    if(isPrime(num) == true) {
-        return;
+    if (serveSocket.compare("") != 0) {
+        cout << "Serving on " << serveSocket << "..." << endl;
+        error = maxsum::serve(options, serveSocket, workers);
+        cerr << "ERROR: " << error << endl;
+        return 1;
     }
-    pyramid->addEdge(0, 1, num);
-    // cout << 0 << "->" << 1 << " w: " << num << endl;
-
-    int index = 2;
-    // Read the pyramid and create edges if the destination node is not prime
-    for (int i = 2; i <= N; i++) {
-        for (int j = 0; j < i; j++, index++) {
-            cout << "Level " << i << ", Number " << j+1 << ": ";
-            cin >> num;
-            if(isPrime(num) == false) {
-                if (j == 0) {
-                    pyramid->addEdge(index-i+1, index, num);
-                } else if (j + 1 == i) {
-                    // cout << index-i << "->" << index << " w: " << num << endl;
-                    pyramid->addEdge(index-i, index, num);
-                } else {
-                    // cout << index-i << "->" << index << " w: " << num << endl;
-                    pyramid->addEdge(index-i, index, num);
-                    // cout << index-i+1 << "->" << index << " w: " << num << endl;
-                    pyramid->addEdge(index-i+1, index, num);
-                }
 
-                if (i == N) {
-                    // cout << index << "->" << index+i-j << " w: " << 0 << endl;
-                    pyramid->addEdge(index, index+i-j, 0);
-                }
-            }
+    if (loadSocket.compare("") != 0) {
+        maxsum::LoadStats stats;
+        error = maxsum::loadTest(loadSocket, options.filename, binary, requests, connections, stats);
+        if (error.compare("") != 0) {
+            cerr << "ERROR: " << error << endl;
+            return 1;
         }
+        cout << "Response: " << stats.response << endl;
+        cout << "Requests: " << stats.requests << " in " << stats.seconds << " s, "
+             << stats.requests / stats.seconds << " requests/s, " << stats.errors << " errors" << endl;
+        cout << "Latency: p50 " << stats.p50 << " us, p90 " << stats.p90 << " us, p99 " << stats.p99
+             << " us, p99.9 " << stats.p999 << " us, max " << stats.max << " us" << endl;
+        return stats.errors > 0 ? 1 : 0;
     }
-}
 
-void readInput(ifstream& inFile, DAG *& pyramid) {
-    /* get level count from file */
-    int Nsum = 0;
-    int N = 0;
-    string data;
-    while (inFile.peek() != EOF) {
-        getline(inFile, data, '\n'); // move to next line
-        Nsum += ++N;
+    if (options.engine.compare("stream") == 0 || options.filename.compare("-") == 0) {
+        ios_base::sync_with_stdio(false); // large inputs on stdin
     }
-    
-    inFile.clear();
-    inFile.seekg(0); // move cursor to start of file
-    
-    pyramid = new DAG(Nsum + 2);
-    
-    int num = 0;
 
-    inFile >> num;
-    if(isPrime(num) == true) {
-        return;
+    if (options.filename.compare("") != 0) {
+        cout << "Trying to open " << options.filename << "..." << endl;
+    } else {
+        cout << "No filename supplied." << endl;
     }
-    pyramid->addEdge(0, 1, num);
-    // cout << 0 << "->" << 1 << " w: " << num << endl;
 
-    int index = 2;
-
-    // Read the pyramid and create edges if the destination node is not prime
-    for (int i = 2; i <= N; i++) {
-        for (int j = 0; j < i; j++, index++) {
-            inFile >> num;
-            if(isPrime(num) == false) {
-                if (j == 0) {
-                    // cout << index-i+1 << "->" << index << " w: " << num << endl;
-                    pyramid->addEdge(index-i+1, index, num);
-                } else if (j + 1 == i) {
-                    // cout << index-i << "->" << index << " w: " << num << endl;
-                    pyramid->addEdge(index-i, index, num);
-                } else {
-                    // cout << index-i << "->" << index << " w: " << num << endl;
-                    pyramid->addEdge(index-i, index, num);
-                    // cout << index-i+1 << "->" << index << " w: " << num << endl;
-                    pyramid->addEdge(index-i+1, index, num);
-                }
+    maxsum::Result result = maxsum::solve(options, cin, &cout);
+    if (result.status != 0) {
+        cerr << "ERROR: " << result.error << endl;
+        return result.status;
+    }
 
-                if (i == N) {
-                    // cout << index << "->" << index+i-j << " w: " << 0 << endl;
-                    pyramid->addEdge(index, index+i-j, 0);
-                }
-            }
+    if (options.top > 0) {
+        for (size_t k = 0; k < result.answers.size(); k++) {
+            cout << result.label << " " << k + 1 << ": " << result.answers[k].value << endl;
+            printPath(result.answers[k].path);
         }
+        return 0;
     }
 
-}
-
-int main (int argc, char** argv) {
-
-    string filename = "";
-
-    if (argc > 1) {
-        filename = argv[1];
-        cout << "Trying to open " << filename << "..." << endl;
-    } else {
-        cout << "No filename supplied." << endl;
+    cout << result.label << ": " << result.answers[0].value << endl;
+    if (options.path.compare("") != 0) {
+        printPath(result.answers[0].path);
     }
-
-    DAG * pyramid = NULL;
-
-
-    if (filename.compare("") == 0) {
-        int N = 0; // level count
-        cout << "Please enter the level count of pyramid: ";
-        cin >> N;
-
-        readInput(N, pyramid);
-    } else {
-        ifstream inFile;
-
-        inFile.open(filename);
-
-        if (!inFile) {
-		    cerr << "ERROR: Can not open input file." << endl;
-		    return 1;
-	    }
-
-        readInput(inFile, pyramid);
-
-        inFile.close();
+    if (options.updates > 0) {
+        cout << "Updates: " << options.updates << ", " << result.updateMicros << " us per update, "
+             << result.fullMicros << " us per full solve" << endl;
     }
-
-    pyramid->maximumSum();
-
-    delete pyramid;
-    
     return 0;
-}
\ No newline at end of file
+}
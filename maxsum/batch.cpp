@@ -0,0 +1,432 @@
+#include <algorithm> // sort
+#include <atomic> // atomic
+#include <chrono> // steady_clock
+#include <condition_variable> // condition_variable
+#include <deque> // deque
+#include <fstream> // ifstream
+#include <mutex> // mutex, lock_guard, unique_lock
+#include <sstream> // ostringstream
+#include <string> // string, getline, to_string
+#include <thread> // thread
+#include <vector> // STL Vector
+#if defined(__unix__) || defined(__APPLE__)
+#include <dirent.h> // opendir, readdir, closedir
+#include <sys/stat.h> // stat
+#endif
+
+#include "batch.h"
+#include "primes.h"
+
+namespace maxsum {
+
+WorkerStats::WorkerStats() {
+    this->pyramids = 0;
+    this->stolen = 0;
+    this->busySeconds = 0;
+}
+
+BatchStats::BatchStats() {
+    this->pyramids = 0;
+    this->errors = 0;
+    this->bytes = 0;
+    this->seconds = 0;
+}
+
+namespace {
+
+void writeLine(const std::string& name, const Result& result, bool paths, std::ostream& output) {
+    output << name;
+    if (result.status != 0) {
+        output << "\tERROR " << result.error << '\n';
+        return;
+    }
+    for (size_t k = 0; k < result.answers.size(); k++) {
+        output << '\t' << result.answers[k].value;
+        if (paths == true) {
+            output << '\t' << formatPath(result.answers[k].path);
+        }
+    }
+    output << '\n';
+}
+
+bool isBlank(const std::string& line) {
+    return line.find_first_not_of(" \t\r\v\f") == std::string::npos;
+}
+
+bool appendFile(const std::string& filename, std::string& text) {
+    // Appends the whole file to text, which is left as it was if it can not be read
+    std::ifstream inFile;
+    inFile.open(filename, std::ios::binary);
+    if (!inFile) {
+        return false;
+    }
+    inFile.seekg(0, std::ios::end);
+    std::streamoff size = inFile.tellg();
+    if (size < 0) {
+        return false;
+    }
+    inFile.seekg(0, std::ios::beg);
+    size_t start = text.size();
+    text.resize(start + (size_t) size);
+    inFile.read(&text[start], size);
+    if (!inFile && size != 0) {
+        text.resize(start);
+        return false;
+    }
+    return true;
+}
+
+bool listDirectory(const std::string& directory, std::vector<std::string>& names) {
+    // Regular files of directory sorted by name, false if it is not a directory
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat info;
+    if (stat(directory.c_str(), &info) != 0 || S_ISDIR(info.st_mode) == false) {
+        return false;
+    }
+    DIR *dir = opendir(directory.c_str());
+    if (dir == NULL) {
+        return false;
+    }
+    for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name[0] != '.' && stat((directory + "/" + name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return true;
+#else
+    (void) directory;
+    (void) names;
+    return false;
+#endif
+}
+
+struct BatchTask {
+    std::vector<std::string> names; // one per pyramid, several with lanes
+    std::string text; // the pyramids one after another, the allocation is kept for the later tasks of the slot
+    std::vector<size_t> ends; // where each pyramid ends in text
+    std::vector<unsigned char> unreadable; // whether the file of each pyramid could not be read
+    std::string line; // the answers, written once done
+    bool done;
+};
+
+void addPyramid(BatchTask& task, const std::string& name, bool unreadable) {
+    // the pyramid is the text appended since the last one
+    task.names.push_back(name);
+    task.ends.push_back(task.text.size());
+    task.unreadable.push_back(unreadable);
+}
+
+const size_t maxPending = (size_t) 64 << 20; // bytes of text read ahead of the lines written
+
+struct TaskQueue {
+    std::mutex lock;
+    std::deque<long long> tasks; // the owner takes from the front, thieves from the back
+};
+
+struct BatchPool {
+    bool paths; // written next to the values
+    size_t group; // pyramids per task
+    std::ostream *output;
+    BatchStats *stats;
+    PrimeSieve sieve; // shared by the solvers
+    std::vector<Solver *> solvers; // one per worker
+    std::vector<TaskQueue *> queues; // one per worker
+    std::vector<BatchTask> tasks; // ring of slots, task k uses slot k % tasks.size()
+    long long submitted; // tasks queued so far
+    long long written; // tasks whose line is written, in order
+    size_t pending; // bytes of text of the tasks queued but not written, only used by the reading thread
+    std::vector<std::thread> workers;
+    std::mutex lock; // guards done, sleeping workers and the waiting writer
+    std::condition_variable wake; // a task was queued
+    std::condition_variable finished; // a task is done
+    std::atomic<long long> queued; // tasks in the queues
+    bool stopping;
+
+    BatchPool(const Options& options, int workerCount, std::ostream& output, BatchStats& stats);
+    ~BatchPool();
+
+    BatchTask& next(); // the slot of the next task, writes the lines done before it in order
+    void submit(); // queues the task of next()
+    void write(); // writes the line of the oldest task, which is done
+    void finish(); // waits until every line is written
+    bool take(int id, long long& k); // own tasks first, then stolen ones
+    void work(int id);
+};
+
+BatchPool::BatchPool(const Options& options, int workerCount, std::ostream& output, BatchStats& stats)
+    : sieve(options.sieveLimit) {
+    this->paths = options.path.compare("") != 0 || options.top > 0;
+    this->group = options.lanes == true ? 32 : 1; // a few runs of vector lanes
+    this->output = &output;
+    this->stats = &stats;
+    for (int w = 0; w < workerCount; w++) {
+        this->solvers.push_back(new Solver(options, &this->sieve));
+        this->queues.push_back(new TaskQueue());
+    }
+    this->tasks.resize((size_t) workerCount * 256); // room to run ahead of a large pyramid, see maxPending
+    this->submitted = 0;
+    this->written = 0;
+    this->pending = 0;
+    this->queued = 0;
+    this->stopping = false;
+    this->stats->workers.assign(workerCount, WorkerStats());
+    if (this->solvers[0]->error.compare("") == 0) {
+        for (int w = 0; w < workerCount; w++) {
+            this->workers.push_back(std::thread(&BatchPool::work, this, w));
+        }
+    }
+}
+
+BatchPool::~BatchPool() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (size_t w = 0; w < this->workers.size(); w++) {
+        this->workers[w].join();
+    }
+    for (size_t w = 0; w < this->solvers.size(); w++) {
+        delete this->solvers[w];
+        delete this->queues[w];
+    }
+}
+
+BatchTask& BatchPool::next()
+{
+    long long size = (long long) this->tasks.size();
+    while (true) {
+        // lines are written outside the lock, done tasks are not touched by the workers
+        // the reader also waits once the queued text is too large, however few tasks hold it
+        bool ready = false;
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            if (this->submitted - this->written >= size ||
+                (this->written < this->submitted && this->pending > maxPending)) {
+                this->finished.wait(guard, [this, size] { return this->tasks[this->written % size].done; });
+            }
+            ready = this->written < this->submitted && this->tasks[this->written % size].done;
+        }
+        if (ready == false) {
+            break;
+        }
+        this->write();
+    }
+    BatchTask& task = this->tasks[this->submitted % size];
+    task.names.clear();
+    task.text.clear();
+    task.ends.clear();
+    task.unreadable.clear();
+    return task;
+}
+
+void BatchPool::submit()
+{
+    long long k = this->submitted++;
+    this->tasks[k % this->tasks.size()].done = false;
+    this->pending += this->tasks[k % this->tasks.size()].text.size();
+    TaskQueue *queue = this->queues[k % this->queues.size()]; // round robin, stealing evens out the sizes
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->tasks.push_back(k);
+    }
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->queued++;
+    }
+    this->wake.notify_one();
+}
+
+void BatchPool::finish()
+{
+    long long size = (long long) this->tasks.size();
+    while (this->written < this->submitted) {
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->finished.wait(guard, [this, size] { return this->tasks[this->written % size].done; });
+        }
+        this->write();
+    }
+}
+
+void BatchPool::write()
+{
+    // slots keep their buffers for the next tasks, up to their share of maxPending
+    BatchTask& task = this->tasks[this->written % this->tasks.size()];
+    *this->output << task.line;
+    this->pending -= task.text.size();
+    if (task.text.capacity() > maxPending / this->tasks.size()) {
+        std::string().swap(task.text);
+    }
+    if (task.line.capacity() > maxPending / this->tasks.size()) {
+        std::string().swap(task.line);
+    }
+    this->written++;
+}
+
+bool BatchPool::take(int id, long long& k)
+{
+    int count = (int) this->queues.size();
+    for (int i = 0; i < count; i++) {
+        TaskQueue *queue = this->queues[(id + i) % count];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        if (queue->tasks.empty() == true) {
+            continue;
+        }
+        if (i == 0) {
+            k = queue->tasks.front();
+            queue->tasks.pop_front();
+        } else {
+            k = queue->tasks.back(); // the newest task, the furthest from being written
+            queue->tasks.pop_back();
+            this->stats->workers[id].stolen += (long long) this->tasks[k % this->tasks.size()].names.size();
+        }
+        this->queued--;
+        return true;
+    }
+    return false;
+}
+
+void BatchPool::work(int id)
+{
+    typedef std::chrono::steady_clock Clock;
+    Solver *solver = this->solvers[id];
+    WorkerStats& worker = this->stats->workers[id];
+    std::ostringstream line; // reused for every answer
+    std::vector<const char *> texts;
+    std::vector<size_t> lengths;
+    std::vector<Result> results;
+    while (true) {
+        long long k = 0;
+        if (this->take(id, k) == false) {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->wake.wait(guard, [this] { return this->queued > 0 || this->stopping == true; });
+            if (this->queued == 0) {
+                return; // stopping
+            }
+            continue;
+        }
+
+        Clock::time_point start = Clock::now();
+        BatchTask& task = this->tasks[k % this->tasks.size()];
+        size_t count = task.names.size();
+        texts.resize(count);
+        lengths.resize(count);
+        results.assign(count, Result());
+        for (size_t p = 0; p < count; p++) {
+            size_t begin = p > 0 ? task.ends[p - 1] : 0;
+            texts[p] = task.text.data() + begin;
+            lengths[p] = task.ends[p] - begin;
+        }
+        solver->solve(texts.data(), lengths.data(), count, results.data());
+
+        line.str("");
+        for (size_t p = 0; p < count; p++) {
+            if (task.unreadable[p] == true) {
+                results[p] = Result();
+                results[p].status = 1;
+                results[p].error = "Can not open input file.";
+            }
+            writeLine(task.names[p], results[p], this->paths, line);
+        }
+        task.line = line.str();
+        worker.busySeconds += std::chrono::duration<double>(Clock::now() - start).count();
+        worker.pyramids += (long long) count;
+
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            task.done = true;
+        }
+        this->finished.notify_one();
+    }
+}
+
+void readPyramids(BatchPool& pool, std::istream& in, BatchStats& stats) {
+    // Pyramids end at blank lines, each is read straight into its task
+    BatchTask *task = &pool.next();
+    size_t start = 0; // where the pyramid being read starts in the text of the task
+    std::string line;
+    bool more = true;
+    while (more == true) {
+        more = (bool) std::getline(in, line);
+        if (more == true && isBlank(line) == false) {
+            task->text += line;
+            task->text += '\n';
+            continue;
+        }
+        if (task->text.size() > start) {
+            stats.pyramids++;
+            stats.bytes += (long long) (task->text.size() - start);
+            addPyramid(*task, std::to_string(stats.pyramids), false);
+            start = task->text.size();
+        }
+        if (task->names.size() == pool.group || (more == false && task->names.empty() == false)) {
+            pool.submit();
+            task = &pool.next();
+            start = 0;
+        }
+    }
+}
+
+} // namespace
+
+std::string solveBatch(const Options& options, int workers, std::istream& input, std::ostream& output,
+                       BatchStats& stats)
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    if (workers <= 0) {
+        workers = (int) std::thread::hardware_concurrency();
+    }
+    if (workers <= 0) {
+        workers = 1;
+    }
+    BatchPool pool(options, workers, output, stats);
+    if (pool.solvers[0]->error.compare("") != 0) {
+        return pool.solvers[0]->error;
+    }
+
+    std::string filename = options.filename;
+    std::vector<std::string> names;
+    if (filename.compare("") == 0 || filename.compare("-") == 0) {
+        readPyramids(pool, input, stats);
+    } else if (listDirectory(filename, names) == true) {
+        BatchTask *task = &pool.next();
+        for (size_t k = 0; k < names.size(); k++) {
+            size_t start = task->text.size();
+            bool unreadable = appendFile(filename + "/" + names[k], task->text) == false;
+            if (unreadable == true) {
+                stats.errors++;
+            }
+            stats.pyramids++;
+            stats.bytes += (long long) (task->text.size() - start);
+            addPyramid(*task, names[k], unreadable);
+            if (task->names.size() == pool.group || k + 1 == names.size()) {
+                pool.submit();
+                task = &pool.next();
+            }
+        }
+    } else {
+        std::ifstream inFile;
+
+        inFile.open(filename);
+
+        if (!inFile) {
+            return "Can not open input file.";
+        }
+
+        readPyramids(pool, inFile, stats);
+
+        inFile.close();
+    }
+
+    pool.finish();
+    output.flush();
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return "";
+}
+
+} // namespace maxsum
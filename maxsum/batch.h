@@ -0,0 +1,54 @@
+#ifndef MAXSUM_BATCH_H
+#define MAXSUM_BATCH_H
+
+#include <istream> // istream
+#include <ostream> // ostream
+#include <string> // string
+#include <vector> // STL Vector
+
+#include "maxsum.h"
+
+/*
+ * Batch mode: many small pyramids solved by long-lived Solvers, so storage and primes
+ * are reused instead of paying for a process and allocations per pyramid.
+ * Pyramids come either from one stream, separated by blank lines, or one per
+ * file of a directory (sorted by name, hidden files skipped).
+ * Each gets the line "<name>\t<value>" where name is the 1-based position in
+ * the stream or the file name, followed by "\t<path>" (see formatPath) if paths
+ * or top sums are asked for, repeated for each top sum. An unreadable file gets
+ * "<name>\tERROR <message>".
+ * Pyramids are solved concurrently by workers that each own a Solver and a
+ * queue of pyramids, idle workers steal from the queues of busy ones, and the
+ * lines are still written in input order. The Solvers share one prime sieve.
+ * With options.lanes a task holds a run of pyramids and those of the same height
+ * are solved side by side, one per vector lane (see LaneSum in pyramid.h).
+ */
+
+namespace maxsum {
+
+struct WorkerStats {
+    long long pyramids; // solved by the worker
+    long long stolen; // of them taken from the queue of another worker, pyramids and not tasks
+    double busySeconds; // spent solving, utilization is busySeconds / BatchStats::seconds
+
+    WorkerStats();
+};
+
+struct BatchStats {
+    long long pyramids; // lines written
+    long long errors; // files that could not be read
+    long long bytes; // of pyramid text
+    double seconds; // wall time of the whole batch
+    std::vector<WorkerStats> workers;
+
+    BatchStats();
+};
+
+// Solves the directory or file options.filename, or input if it is "" or "-",
+// on workers threads (0 for one per core), returns why the batch could not run or ""
+std::string solveBatch(const Options& options, int workers, std::istream& input, std::ostream& output,
+                       BatchStats& stats);
+
+} // namespace maxsum
+
+#endif // MAXSUM_BATCH_H
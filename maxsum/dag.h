@@ -0,0 +1,233 @@
+#ifndef MAXSUM_DAG_H
+#define MAXSUM_DAG_H
+
+#include <algorithm> // copy, fill, reverse
+#include <vector> // STL Vector
+
+namespace maxsum {
+
+template <class Index, class Weight>
+struct DAG {
+    Index vertexAmount;   // count of vertices
+    Index edgeAmount; // count of edges between non-prime numbers
+    Index *offsets; // edges of vertex v are at [offsets[v], offsets[v+1])
+    Index *targets; // destination vertex of each edge
+    Weight *weights; // weight of each edge, the number it leads to
+    bool * visited; // holds whether a vertex has been visited (for sorting)
+    Index *order; // vertices in topological order, filled by topologicalSort()
+    Index *stackVertex; // path from the root of the depth-first search
+    Index *stackEdge; // next edge to follow on that path
+    bool topologicallyOrdered; // every edge goes to a higher vertex, no sorting needed
+
+    DAG(Index vertexAmount);
+    ~DAG();
+
+    void topologicalSort();
+    template <class S> // fills path with the vertices after the source if not NULL
+    typename S::Value maximumSum(const S& semiring, std::vector<Index> *path = NULL);
+};
+  
+template <class Index, class Weight>
+DAG<Index, Weight>::DAG(Index vertexAmount) {
+    this->vertexAmount = vertexAmount;
+    this->edgeAmount = 0;
+    this->offsets = new Index[vertexAmount + 1] ();
+    this->visited = NULL;
+    this->order = NULL;
+    this->stackVertex = NULL;
+    this->stackEdge = NULL;
+    this->topologicallyOrdered = true;
+    this->targets = NULL;
+    this->weights = NULL;
+}
+
+template <class Index, class Weight>
+DAG<Index, Weight>::~DAG() {
+    delete [] offsets;
+    delete [] visited;
+    delete [] order;
+    delete [] stackVertex;
+    delete [] stackEdge;
+    delete [] targets;
+    delete [] weights;
+}
+
+template <class Index, class Weight>
+struct DAGBuilder {
+    DAG<Index, Weight> *dag; // graph under construction
+    Index lastSource; // of the last edge, edges are added in non-decreasing source order
+    Index edgeCapacity; // allocated length of targets and weights
+
+    DAGBuilder(Index vertexAmount, Index edgeCapacity);
+    ~DAGBuilder();
+
+    // false, leaving the graph unchanged, for a source before lastSource or a vertex out of range
+    bool addEdge(Index source, Index destination, Weight weight);
+    DAG<Index, Weight> *build(); // hands the graph over to the caller
+};
+
+template <class Index, class Weight>
+DAGBuilder<Index, Weight>::DAGBuilder(Index vertexAmount, Index edgeCapacity) {
+    this->dag = new DAG<Index, Weight>(vertexAmount);
+    this->lastSource = 0;
+    this->edgeCapacity = edgeCapacity > 0 ? edgeCapacity : 1;
+    this->dag->targets = new Index[this->edgeCapacity];
+    this->dag->weights = new Weight[this->edgeCapacity];
+}
+
+template <class Index, class Weight>
+DAGBuilder<Index, Weight>::~DAGBuilder() {
+    delete dag; // only set if build() was not called
+}
+
+template <class Index, class Weight>
+bool DAGBuilder<Index, Weight>::addEdge(Index source, Index destination, Weight weight)
+{
+    // Time Complexity: amortized O(1), offsets are filled as the source advances
+    if (source < lastSource || source >= dag->vertexAmount || destination < 0 || destination >= dag->vertexAmount) {
+        return false; // the edges of earlier sources are closed already
+    }
+    if (dag->edgeAmount == edgeCapacity) {
+        edgeCapacity *= 2;
+        Index *targets = new Index[edgeCapacity];
+        Weight *weights = new Weight[edgeCapacity];
+        std::copy(dag->targets, dag->targets + dag->edgeAmount, targets);
+        std::copy(dag->weights, dag->weights + dag->edgeAmount, weights);
+        delete [] dag->targets;
+        delete [] dag->weights;
+        dag->targets = targets;
+        dag->weights = weights;
+    }
+
+    while (lastSource < source) {
+        dag->offsets[++lastSource] = dag->edgeAmount;
+    }
+    dag->targets[dag->edgeAmount] = destination;
+    dag->weights[dag->edgeAmount] = weight;
+    if (destination <= source) {
+        dag->topologicallyOrdered = false;
+    }
+    dag->edgeAmount++;
+    return true;
+}
+
+template <class Index, class Weight>
+DAG<Index, Weight> *DAGBuilder<Index, Weight>::build()
+{
+    while (lastSource < dag->vertexAmount) {
+        dag->offsets[++lastSource] = dag->edgeAmount;
+    }
+    DAG<Index, Weight> *result = dag;
+    dag = NULL;
+    return result;
+}
+
+template <class Index, class Weight>
+void DAG<Index, Weight>::topologicalSort()
+{
+    // Time Complexity: O(V + E), depth-first with an explicit stack so that
+    // deep graphs do not overflow the thread stack.
+    // Finished vertices are put into order from the back (reverse postorder).
+    // The arrays are allocated by the first sort and reused by the next ones.
+    Index position = this->vertexAmount;
+
+    if (this->order == NULL) {
+        this->order = new Index[this->vertexAmount];
+        this->visited = new bool[this->vertexAmount];
+        this->stackVertex = new Index[this->vertexAmount];
+        this->stackEdge = new Index[this->vertexAmount];
+    }
+
+    // Mark all the vertices as not visited
+    std::fill(this->visited, this->visited + this->vertexAmount, false);
+
+    for (Index root = 0; root < this->vertexAmount; root++) {
+        if (visited[root] == true) {
+            continue;
+        }
+        Index top = 0;
+        stackVertex[0] = root;
+        stackEdge[0] = this->offsets[root];
+        visited[root] = true;
+
+        while (top >= 0) {
+            Index vertex = stackVertex[top];
+            if (stackEdge[top] == this->offsets[vertex + 1]) {
+                this->order[--position] = vertex;
+                top--;
+                continue;
+            }
+            Index next = this->targets[stackEdge[top]++];
+            if (visited[next] == false) {
+                visited[next] = true;
+                top++;
+                stackVertex[top] = next;
+                stackEdge[top] = this->offsets[next];
+            }
+        }
+    }
+}
+  
+template <class Index, class Weight>
+template <class S>
+typename S::Value DAG<Index, Weight>::maximumSum(const S& semiring, std::vector<Index> *path)
+{
+    // Time Complexity: O(V + E) where V are Vertices and E are Edges
+    typedef typename S::Value Value;
+    const Value UNREACHED = semiring.zero();
+    Value *sum = new Value[vertexAmount];
+    Index *parent = path != NULL ? new Index[vertexAmount] : NULL; // vertex each sum came from
+
+    if (this->topologicallyOrdered == false) {
+        this->topologicalSort();
+    }
+  
+    for (Index i = 0; i < this->vertexAmount; i++) {
+        sum[i] = UNREACHED;
+    }
+    sum[0] = semiring.one(); // Initialize the sum to 0
+  
+    for (Index k = 0; k < this->vertexAmount; k++)
+    {
+        // vertex numbers are already a topological order for layered graphs
+        Index source = this->topologicallyOrdered == true ? k : this->order[k];
+  
+        if (sum[source] != UNREACHED)
+        {
+            for (Index e = this->offsets[source]; e < this->offsets[source + 1]; e++) {
+                Index target = this->targets[e];
+                Value best = semiring.plus(sum[target], semiring.times(sum[source], this->weights[e]));
+                if (parent != NULL && best != sum[target]) {
+                    parent[target] = source; // ties keep the earlier edge
+                }
+                sum[target] = best;
+            }
+        }
+    }
+
+    // the sum of the last reachable vertex, the stop node if it is reached
+    Value result = semiring.one();
+    if (path != NULL) {
+        path->clear();
+    }
+    for (Index i = this->vertexAmount - 1; i >= 0; i--) {
+        if (sum[i] != UNREACHED) {
+            result = sum[i];
+            if (path != NULL) {
+                path->clear();
+                for (Index v = i; v != 0; v = parent[v]) {
+                    path->push_back(v);
+                }
+                std::reverse(path->begin(), path->end());
+            }
+            break;
+        }
+    }
+    delete [] sum;
+    delete [] parent;
+    return result;
+}
+
+} // namespace maxsum
+
+#endif // MAXSUM_DAG_H
@@ -0,0 +1,485 @@
+#ifndef MAXSUM_KERNELS_H
+#define MAXSUM_KERNELS_H
+
+#include <climits> // INT_MIN, LLONG_MIN
+#include <cstring> // memcpy
+#include <string> // string
+#include <vector> // STL Vector
+#include <thread> // thread, this_thread::yield
+#include <mutex> // mutex, lock_guard, unique_lock
+#include <condition_variable> // condition_variable
+#include <atomic> // atomic
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // AVX2 intrinsics
+#endif
+
+#include "semiring.h"
+
+namespace maxsum {
+
+template <class Index, class S>
+bool relaxLevelScalar(const S& semiring, const typename S::Value *prev, typename S::Value *cur,
+                      const typename S::Number *row, const unsigned char *admissible, Index width,
+                      unsigned long long *choices)
+{
+    // cur[j] = times(plus(prev[j-1], prev[j]), row[j-1]) for j in [1, width] if the number
+    // is admissible and a parent is reachable, zero() otherwise.
+    // Unless choices is NULL, bit j-1 is set if number j takes the right parent, ties go to
+    // the left one, in (width + 63) / 64 words that are overwritten.
+    typedef typename S::Value Value;
+    const Value UNREACHABLE = semiring.zero();
+    bool reachable = false;
+    if (choices == NULL) {
+        for (Index j = 1; j <= width; j++) {
+            Value parent = semiring.plus(prev[j - 1], prev[j]);
+            if (parent != UNREACHABLE && admissible[j - 1]) {
+                cur[j] = semiring.times(parent, row[j - 1]);
+                reachable = true;
+            } else {
+                cur[j] = UNREACHABLE;
+            }
+        }
+        return reachable;
+    }
+
+    // a word of choices per 64 numbers, the comparison is that of plus()
+    for (Index first = 1; first <= width; first += 64) {
+        int count = width - first + 1 < 64 ? (int) (width - first + 1) : 64;
+        unsigned long long word = 0;
+        for (int b = 0; b < count; b++) {
+            Index j = first + b;
+            Value parent = semiring.plus(prev[j - 1], prev[j]);
+            bool valid = parent != UNREACHABLE && admissible[j - 1];
+            cur[j] = valid ? semiring.times(parent, row[j - 1]) : UNREACHABLE;
+            reachable = reachable || valid;
+            word |= (unsigned long long) (parent != prev[j - 1]) << b;
+        }
+        choices[(first - 1) / 64] = word;
+    }
+    return reachable;
+}
+
+const int LANES = 8; // pyramids relaxed side by side by the lane kernels
+
+template <class Index, class S>
+unsigned relaxLanesScalar(const S& semiring, const typename S::Value *prev, typename S::Value *cur,
+                          const typename S::Number *row, const unsigned char *admissible, Index width)
+{
+    // relaxLevelScalar for LANES pyramids of the same height at once, number j of lane l
+    // is at j * LANES + l, returns the lanes with a reachable number as a bit mask
+    typedef typename S::Value Value;
+    const Value UNREACHABLE = semiring.zero();
+    unsigned reachable = 0;
+    for (Index j = 1; j <= width; j++) {
+        for (int l = 0; l < LANES; l++) {
+            Value parent = semiring.plus(prev[(j - 1) * LANES + l], prev[j * LANES + l]);
+            if (parent != UNREACHABLE && admissible[(j - 1) * LANES + l]) {
+                cur[j * LANES + l] = semiring.times(parent, row[(j - 1) * LANES + l]);
+                reachable |= 1u << l;
+            } else {
+                cur[j * LANES + l] = UNREACHABLE;
+            }
+        }
+    }
+    return reachable;
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL 1
+
+template <class Index, class S>
+void storeChoices(const S& semiring, const typename S::Value *prev, Index j, Index width, unsigned long long word,
+                  unsigned long long *choices)
+{
+    // Completes the choices of a vector kernel from number j on, word holds those of the
+    // numbers before j since the last full word
+    for (; j <= width; j++) {
+        word |= (unsigned long long) (semiring.plus(prev[j - 1], prev[j]) != prev[j - 1]) << ((j - 1) % 64);
+        if ((j - 1) % 64 == 63) {
+            choices[(j - 1) / 64] = word;
+            word = 0;
+        }
+    }
+    if (width % 64 != 0) {
+        choices[(width - 1) / 64] = word;
+    }
+}
+
+template <class Index>
+__attribute__((target("avx2")))
+bool relaxLevelAVX2(const MaxPlus<int>& semiring, const int *prev, int *cur, const int *row,
+                    const unsigned char *admissible, Index width, unsigned long long *choices)
+{
+    // Same as relaxLevelScalar for MaxPlus, 8 numbers at a time,
+    // the choices are the sign bits of right > left
+    const __m256i unreachable = _mm256_set1_epi32(INT_MIN);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i reachable = zero;
+    unsigned long long word = 0;
+
+    Index j = 1;
+    for (; j + 7 <= width; j += 8) {
+        __m256i left = _mm256_loadu_si256((const __m256i *) (prev + j - 1));
+        __m256i right = _mm256_loadu_si256((const __m256i *) (prev + j));
+        __m256i parent = _mm256_max_epi32(left, right);
+        __m256i numbers = _mm256_loadu_si256((const __m256i *) (row + j - 1));
+        __m256i allowed = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (admissible + j - 1)));
+
+        __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(parent, unreachable),
+                                            _mm256_cmpgt_epi32(allowed, zero));
+        __m256i sum = _mm256_add_epi32(parent, numbers);
+        _mm256_storeu_si256((__m256i *) (cur + j), _mm256_blendv_epi8(unreachable, sum, valid));
+        reachable = _mm256_or_si256(reachable, valid);
+
+        if (choices != NULL) {
+            unsigned long long fromRight = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(right, left)));
+            word |= fromRight << ((j - 1) % 64);
+            if ((j - 1) % 64 == 56) {
+                choices[(j - 1) / 64] = word;
+                word = 0;
+            }
+        }
+    }
+
+    if (choices != NULL) {
+        storeChoices(semiring, prev, j, width, word, choices);
+    }
+    bool tail = relaxLevelScalar(semiring, prev + j - 1, cur + j - 1, row + j - 1, admissible + j - 1,
+                                 width - j + 1, NULL);
+    return tail || _mm256_testz_si256(reachable, reachable) == 0;
+}
+
+template <class Index>
+__attribute__((target("avx2")))
+bool relaxLevelAVX2(const MaxPlus<long long>& semiring, const long long *prev, long long *cur,
+                    const long long *row, const unsigned char *admissible, Index width, unsigned long long *choices)
+{
+    // Same as relaxLevelScalar for MaxPlus, 4 numbers at a time (AVX2 has no 64-bit max, compare and blend),
+    // the choices are the sign bits of right > left
+    const __m256i unreachable = _mm256_set1_epi64x(LLONG_MIN);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i reachable = zero;
+    unsigned long long word = 0;
+
+    Index j = 1;
+    for (; j + 3 <= width; j += 4) {
+        __m256i left = _mm256_loadu_si256((const __m256i *) (prev + j - 1));
+        __m256i right = _mm256_loadu_si256((const __m256i *) (prev + j));
+        __m256i fromRight = _mm256_cmpgt_epi64(right, left);
+        __m256i parent = _mm256_blendv_epi8(left, right, fromRight);
+        __m256i numbers = _mm256_loadu_si256((const __m256i *) (row + j - 1));
+        int flags;
+        memcpy(&flags, admissible + j - 1, sizeof(flags));
+        __m256i allowed = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(flags));
+
+        __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi64(parent, unreachable),
+                                            _mm256_cmpgt_epi64(allowed, zero));
+        __m256i sum = _mm256_add_epi64(parent, numbers);
+        _mm256_storeu_si256((__m256i *) (cur + j), _mm256_blendv_epi8(unreachable, sum, valid));
+        reachable = _mm256_or_si256(reachable, valid);
+
+        if (choices != NULL) {
+            word |= (unsigned long long) (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(fromRight)) << ((j - 1) % 64);
+            if ((j - 1) % 64 == 60) {
+                choices[(j - 1) / 64] = word;
+                word = 0;
+            }
+        }
+    }
+
+    if (choices != NULL) {
+        storeChoices(semiring, prev, j, width, word, choices);
+    }
+    bool tail = relaxLevelScalar(semiring, prev + j - 1, cur + j - 1, row + j - 1, admissible + j - 1,
+                                 width - j + 1, NULL);
+    return tail || _mm256_testz_si256(reachable, reachable) == 0;
+}
+
+template <class Index>
+__attribute__((target("avx2")))
+unsigned relaxLanesAVX2(const MaxPlus<int>&, const int *prev, int *cur, const int *row,
+                        const unsigned char *admissible, Index width)
+{
+    // Same as relaxLanesScalar for MaxPlus, one vector holds a number of all 8 lanes
+    static_assert(LANES == 8, "one vector per number");
+    const __m256i unreachable = _mm256_set1_epi32(INT_MIN);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i reachable = zero;
+
+    __m256i left = _mm256_loadu_si256((const __m256i *) prev);
+    for (Index j = 1; j <= width; j++) {
+        __m256i right = _mm256_loadu_si256((const __m256i *) (prev + j * 8));
+        __m256i parent = _mm256_max_epi32(left, right);
+        __m256i numbers = _mm256_loadu_si256((const __m256i *) (row + (j - 1) * 8));
+        __m256i allowed = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (admissible + (j - 1) * 8)));
+
+        __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(parent, unreachable),
+                                            _mm256_cmpgt_epi32(allowed, zero));
+        __m256i sum = _mm256_add_epi32(parent, numbers);
+        _mm256_storeu_si256((__m256i *) (cur + j * 8), _mm256_blendv_epi8(unreachable, sum, valid));
+        reachable = _mm256_or_si256(reachable, valid);
+        left = right;
+    }
+
+    return (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(reachable));
+}
+
+template <class Index>
+__attribute__((target("avx2")))
+unsigned relaxLanesAVX2(const MaxPlus<long long>&, const long long *prev, long long *cur, const long long *row,
+                        const unsigned char *admissible, Index width)
+{
+    // Same as relaxLanesScalar for MaxPlus, two vectors hold a number of all 8 lanes
+    static_assert(LANES == 8, "two vectors per number");
+    const __m256i unreachable = _mm256_set1_epi64x(LLONG_MIN);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i reachable[2] = {zero, zero};
+
+    for (Index j = 1; j <= width; j++) {
+        for (int h = 0; h < 2; h++) {
+            __m256i left = _mm256_loadu_si256((const __m256i *) (prev + (j - 1) * 8 + 4 * h));
+            __m256i right = _mm256_loadu_si256((const __m256i *) (prev + j * 8 + 4 * h));
+            __m256i parent = _mm256_blendv_epi8(right, left, _mm256_cmpgt_epi64(left, right));
+            __m256i numbers = _mm256_loadu_si256((const __m256i *) (row + (j - 1) * 8 + 4 * h));
+            int flags;
+            memcpy(&flags, admissible + (j - 1) * 8 + 4 * h, sizeof(flags));
+            __m256i allowed = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(flags));
+
+            __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi64(parent, unreachable),
+                                                _mm256_cmpgt_epi64(allowed, zero));
+            __m256i sum = _mm256_add_epi64(parent, numbers);
+            _mm256_storeu_si256((__m256i *) (cur + j * 8 + 4 * h), _mm256_blendv_epi8(unreachable, sum, valid));
+            reachable[h] = _mm256_or_si256(reachable[h], valid);
+        }
+    }
+
+    return (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(reachable[0])) |
+           (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(reachable[1])) << 4;
+}
+#endif
+
+template <class Index, class S>
+using RelaxKernel = bool (*)(const S& semiring, const typename S::Value *prev, typename S::Value *cur,
+                             const typename S::Number *row, const unsigned char *admissible, Index width,
+                             unsigned long long *choices);
+
+template <class Index, class S>
+using LaneKernel = unsigned (*)(const S& semiring, const typename S::Value *prev, typename S::Value *cur,
+                                const typename S::Number *row, const unsigned char *admissible, Index width);
+
+template <class Index, class S>
+struct VectorKernel {
+    static RelaxKernel<Index, S> avx2() { return NULL; } // no vector kernel for this semiring
+    static LaneKernel<Index, S> lanesAVX2() { return NULL; }
+};
+
+#ifdef HAVE_AVX2_KERNEL
+template <class Index>
+struct VectorKernel<Index, MaxPlus<int> > {
+    static RelaxKernel<Index, MaxPlus<int> > avx2() { return relaxLevelAVX2<Index>; }
+    static LaneKernel<Index, MaxPlus<int> > lanesAVX2() { return relaxLanesAVX2<Index>; }
+};
+
+template <class Index>
+struct VectorKernel<Index, MaxPlus<long long> > {
+    static RelaxKernel<Index, MaxPlus<long long> > avx2() { return relaxLevelAVX2<Index>; }
+    static LaneKernel<Index, MaxPlus<long long> > lanesAVX2() { return relaxLanesAVX2<Index>; }
+};
+#endif
+
+template <class Index, class S>
+struct LevelKernel {
+    // Kept by each solver, so solvers with different kernels can run side by side
+    RelaxKernel<Index, S> relax; // used by RollingSum::addLevel and LevelPool
+    LaneKernel<Index, S> relaxLanes; // used by LaneSum::solve
+
+    LevelKernel(); // the portable kernels
+    bool select(const std::string& name);
+};
+
+template <class Index, class S>
+LevelKernel<Index, S>::LevelKernel() {
+    this->relax = relaxLevelScalar<Index, S>;
+    this->relaxLanes = relaxLanesScalar<Index, S>;
+}
+
+template <class Index, class S>
+bool LevelKernel<Index, S>::select(const std::string& name)
+{
+    // "auto" picks the widest kernel the CPU supports, false if name is unknown or unsupported
+    RelaxKernel<Index, S> avx2 = VectorKernel<Index, S>::avx2();
+    LaneKernel<Index, S> lanesAVX2 = VectorKernel<Index, S>::lanesAVX2();
+#ifdef HAVE_AVX2_KERNEL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") == 0) {
+        avx2 = NULL;
+        lanesAVX2 = NULL;
+    }
+#else
+    avx2 = NULL;
+    lanesAVX2 = NULL;
+#endif
+    if (name.compare("avx2") == 0 || (name.compare("auto") == 0 && avx2 != NULL)) {
+        this->relax = avx2 != NULL ? avx2 : relaxLevelScalar<Index, S>;
+        this->relaxLanes = lanesAVX2 != NULL ? lanesAVX2 : relaxLanesScalar<Index, S>;
+        return avx2 != NULL;
+    }
+    if (name.compare("auto") == 0 || name.compare("scalar") == 0) {
+        this->relax = relaxLevelScalar<Index, S>;
+        this->relaxLanes = relaxLanesScalar<Index, S>;
+        return true;
+    }
+    return false;
+}
+
+template <class Index, class S>
+struct LevelPool {
+    int threadCount; // workers plus the calling thread
+    Index minChunk; // numbers a thread relaxes at least, narrower levels use fewer threads
+    std::vector<std::thread> workers;
+    std::mutex lock; // guards sleeping workers
+    std::condition_variable wake;
+    std::atomic<int> generation; // incremented once per level, workers wait for a change
+    std::atomic<int> remaining; // workers still relaxing the current level
+    std::atomic<int> sleepers; // workers blocked on wake
+    std::atomic<bool> reachable;
+    bool stopping;
+    LevelKernel<Index, S> kernel; // relaxes each chunk
+
+    // current level, split into chunks of at least minChunk numbers, one per thread
+    int chunks;
+    const S *semiring;
+    const typename S::Value *prev;
+    typename S::Value *cur;
+    const typename S::Number *row;
+    const unsigned char *admissible;
+    Index width;
+    unsigned long long *choices;
+
+    LevelPool(int threadCount, const LevelKernel<Index, S>& kernel = LevelKernel<Index, S>());
+    ~LevelPool();
+
+    bool relax(const S& semiring, const typename S::Value *prev, typename S::Value *cur,
+               const typename S::Number *row, const unsigned char *admissible, Index width,
+               unsigned long long *choices);
+    bool relaxChunk(int id);
+    void work(int id);
+};
+
+template <class Index, class S>
+LevelPool<Index, S>::LevelPool(int threadCount, const LevelKernel<Index, S>& kernel) {
+    this->threadCount = threadCount > 1 ? threadCount : 1;
+    this->kernel = kernel;
+    this->minChunk = 8192;
+    this->chunks = 1;
+    this->generation = 0;
+    this->remaining = 0;
+    this->sleepers = 0;
+    this->reachable = false;
+    this->stopping = false;
+    for (int id = 1; id < this->threadCount; id++) {
+        this->workers.push_back(std::thread(&LevelPool::work, this, id));
+    }
+}
+
+template <class Index, class S>
+LevelPool<Index, S>::~LevelPool() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = true;
+        this->generation++;
+    }
+    this->wake.notify_all();
+    for (size_t i = 0; i < this->workers.size(); i++) {
+        this->workers[i].join();
+    }
+}
+
+template <class Index, class S>
+bool LevelPool<Index, S>::relaxChunk(int id)
+{
+    // chunks are multiples of 64 numbers so that every vector and every word of choices
+    // stays within one chunk, the threads beyond the chunks of a narrow level have nothing to do
+    if (id >= this->chunks) {
+        return false;
+    }
+    Index chunk = ((this->width + this->chunks - 1) / this->chunks + 63) / 64 * 64;
+    Index start = 1 + id * chunk;
+    Index length = this->width - start + 1 < chunk ? this->width - start + 1 : chunk;
+    if (length <= 0) {
+        return false;
+    }
+    return this->kernel.relax(*this->semiring, this->prev + start - 1, this->cur + start - 1,
+                              this->row + start - 1, this->admissible + start - 1, length,
+                              this->choices != NULL ? this->choices + (start - 1) / 64 : NULL);
+}
+
+template <class Index, class S>
+void LevelPool<Index, S>::work(int id)
+{
+    // Spins briefly between levels since they follow each other quickly, then sleeps
+    int seen = 0;
+    while (true) {
+        int spins = 0;
+        while (this->generation.load(std::memory_order_acquire) == seen) {
+            if (++spins < 4096) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->sleepers++;
+            // seq_cst, paired with relax(): either it sees the new level or relax() sees a sleeper
+            while (this->generation.load() == seen) {
+                this->wake.wait(guard);
+            }
+            this->sleepers--;
+        }
+        seen = this->generation.load(std::memory_order_acquire);
+        if (this->stopping == true) {
+            return;
+        }
+
+        if (this->relaxChunk(id) == true) {
+            this->reachable.store(true, std::memory_order_relaxed);
+        }
+        this->remaining.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+template <class Index, class S>
+bool LevelPool<Index, S>::relax(const S& semiring, const typename S::Value *prev, typename S::Value *cur,
+                                const typename S::Number *row, const unsigned char *admissible, Index width,
+                                unsigned long long *choices)
+{
+    // Same as the level kernel, with one barrier per level
+    Index chunks = width / this->minChunk;
+    if (chunks < 2 || this->threadCount < 2) {
+        return this->kernel.relax(semiring, prev, cur, row, admissible, width, choices);
+    }
+
+    this->chunks = chunks < this->threadCount ? (int) chunks : this->threadCount;
+    this->semiring = &semiring;
+    this->prev = prev;
+    this->cur = cur;
+    this->row = row;
+    this->admissible = admissible;
+    this->width = width;
+    this->choices = choices;
+    this->reachable.store(false, std::memory_order_relaxed);
+    this->remaining.store(this->threadCount - 1, std::memory_order_relaxed);
+    this->generation.fetch_add(1); // seq_cst, published before sleepers is read
+    if (this->sleepers.load() > 0) {
+        std::lock_guard<std::mutex> guard(this->lock); // a worker past its check is waiting already
+        this->wake.notify_all();
+    }
+
+    bool reachable = this->relaxChunk(0);
+    while (this->remaining.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield(); // the other chunks take about as long as this one
+    }
+    return reachable || this->reachable.load(std::memory_order_relaxed);
+}
+
+} // namespace maxsum
+
+#endif // MAXSUM_KERNELS_H
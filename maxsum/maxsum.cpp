@@ -0,0 +1,733 @@
+#include <cerrno> // errno, ERANGE
+#include <climits> // LLONG_MAX
+#include <cstdlib> // strtoll
+#include <chrono> // steady_clock
+#include <fstream> // ifstream
+#include <sstream> // ostringstream
+#include <string> // string
+#include <thread> // thread::hardware_concurrency
+#include <vector> // STL Vector
+
+#include "maxsum.h"
+#include "readers.h"
+
+namespace maxsum {
+
+Options::Options() {
+    this->filename = "";
+    this->engine = "implicit";
+    this->reader = "mmap";
+    this->kernel = "auto";
+    this->sieveLimit = 100000000;
+    this->admit = "not-prime";
+    this->threads = 1;
+    this->indexBits = 32;
+    this->weightBits = 32;
+    this->semiring = "max-plus";
+    this->modulus = 0;
+    this->path = "";
+    this->top = 0;
+    this->updates = 0;
+    this->lanes = false;
+}
+
+Result::Result() {
+    this->status = 0;
+    this->error = "";
+    this->label = "";
+    this->updateMicros = 0;
+    this->fullMicros = 0;
+}
+
+namespace {
+
+template <class Value>
+std::string format(const Value& value) {
+    std::ostringstream out;
+    out << value;
+    return out.str();
+}
+
+template <class Index>
+std::vector<Cell> toPath(const std::vector<Index>& cells) {
+    // cells go down one level at a time from the top-most one
+    std::vector<Cell> path(cells.size());
+    for (Index i = 1; i <= (Index) cells.size(); i++) {
+        path[i - 1].level = i;
+        path[i - 1].number = cells[i - 1] - i * (i - 1) / 2 + 1;
+    }
+    return path;
+}
+
+void fail(Result& result, const std::string& error) {
+    result.status = 1;
+    result.error = error;
+}
+
+template <class Index, class S, class Admit>
+void benchmarkUpdates(Pyramid<Index, typename S::Number> *pyramid, const S& semiring, const Admit& admit,
+                      long long updates, Result& result) {
+    // Changes random numbers to the value of other random numbers and compares
+    // the time of an incremental update with that of a full solve.
+    // The answer is that of the input, the updated pyramid is only checked against a full solve.
+    typedef std::chrono::steady_clock Clock;
+    IncrementalSolver<Index, S, Admit> solver(pyramid, semiring, admit);
+    Answer answer;
+    answer.value = format(solver.result());
+    result.answers.push_back(answer);
+    if (pyramid->cellCount == 0) {
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+    solver.solveAll();
+    result.fullMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    unsigned long long state = 88172645463325252ULL; // xorshift, the same updates on every run
+    start = Clock::now();
+    for (long long u = 0; u < updates; u++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        Index cell = (Index) (state % (unsigned long long) pyramid->cellCount);
+        Index row = 1;
+        while (row * (row + 1) / 2 <= cell) {
+            row++; // O(levels), small next to the update
+        }
+        Index col = cell - row * (row - 1) / 2 + 1;
+        Index other = (Index) ((state >> 32) % (unsigned long long) pyramid->cellCount);
+        solver.updateCell(row, col, pyramid->cells[other]);
+    }
+    result.updateMicros = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / updates;
+
+    typename S::Value value = solver.result();
+    solver.solveAll();
+    if (solver.result() != value) {
+        fail(result, "Incremental and full solve disagree.");
+    }
+}
+
+template <class Index, class S>
+void answerImplicit(const Options& options, const S& semiring, const LevelKernel<Index, S>& kernel,
+                    Pyramid<Index, typename S::Number> *pyramid, LevelPool<Index, S> *pool, Result& result) {
+    // Solves a classified pyramid on its rows, with the best sums if top is set
+    Answer answer;
+    std::vector<Index> cells; // path, row-major from 0
+    if (options.top > 0) {
+        // more sums than paths are never kept
+        long long K = options.top;
+        if (pyramid->levelCount < 62 && K > 1LL << (pyramid->levelCount > 0 ? pyramid->levelCount - 1 : 0)) {
+            K = 1LL << (pyramid->levelCount > 0 ? pyramid->levelCount - 1 : 0);
+        }
+        if (TopSums<Index, S>::fits(pyramid->levelCount, K) == false) {
+            fail(result, "Top " + std::to_string(K) + " sums of " + std::to_string(pyramid->levelCount)
+                 + " levels are too many for " + (sizeof(Index) < 8 ? "32-bit indices, they need --index-bits=64."
+                                                                     : "64-bit indices."));
+            return;
+        }
+        std::vector<typename S::Value> sums;
+        std::vector<std::vector<Index> > paths;
+        if (pyramid->topSums(semiring, (Index) K, sums, paths) == false) {
+            fail(result, "Not enough memory for the top " + std::to_string(K) + " sums of "
+                 + std::to_string(pyramid->levelCount) + " levels.");
+            return;
+        }
+        for (size_t k = 0; k < sums.size(); k++) {
+            answer.value = format(sums[k]);
+            answer.path = toPath(paths[k]);
+            result.answers.push_back(answer);
+        }
+        if (sums.empty() == true) {
+            answer.value = format(semiring.one()); // nothing is reachable
+            result.answers.push_back(answer);
+        }
+    } else {
+        bool path = options.path.compare("") != 0;
+        answer.value = format(pyramid->maximumSum(semiring, pool, path == true ? &cells : NULL, kernel));
+        answer.path = toPath(cells);
+        result.answers.push_back(answer);
+    }
+}
+
+int threadCount(const Options& options) {
+    // 0 threads is one per core
+    return options.threads > 0 ? options.threads : (int) std::thread::hardware_concurrency();
+}
+
+template <class Index, class S, class Admit>
+void solve(const Options& options, const S& semiring, Admit admit, std::istream& input, std::ostream *prompt,
+           Result& result) {
+    typedef typename S::Number Weight;
+    result.label = semiring.label();
+    LevelKernel<Index, S> kernel;
+    if (kernel.select(options.kernel) == false) {
+        fail(result, "Kernel " + options.kernel + " is unknown or not supported for this CPU and semiring.");
+        return;
+    }
+
+    std::string filename = options.filename;
+    std::string engine = options.engine;
+    int threads = threadCount(options);
+    LevelPool<Index, S> levelPool(threads, kernel);
+    LevelPool<Index, S> * pool = threads > 1 ? &levelPool : NULL;
+    Answer answer;
+    std::vector<Index> cells; // path, row-major from 0
+
+    if (engine.compare("stream") == 0) {
+        RollingSum<Index, S> rolling(0, pool, semiring, kernel);
+        bool success = false;
+        std::string error;
+        if (options.path.compare("bits") == 0) {
+            rolling.recordPath();
+        }
+
+        if (filename.compare("") == 0 || filename.compare("-") == 0) {
+            success = readStream(input, rolling, admit, error);
+        } else {
+            std::ifstream inFile;
+
+            inFile.open(filename);
+
+            if (!inFile) {
+                fail(result, "Can not open input file.");
+                return;
+            }
+
+            success = readStream(inFile, rolling, admit, error);
+
+            inFile.close();
+        }
+
+        if (success == false) {
+            fail(result, error);
+            return;
+        }
+        if (options.path.compare("") != 0 && levelsFit<Index>(rolling.lastLevel) == false) {
+            fail(result, tooManyLevels<Index>(rolling.lastLevel)); // cells of the path can not be numbered
+            return;
+        }
+        rolling.path(cells);
+        answer.value = format(rolling.result());
+        answer.path = toPath(cells);
+        result.answers.push_back(answer);
+        return;
+    }
+
+    if (engine.compare("rolling") == 0) {
+        RollingSum<Index, S> rolling(0, pool, semiring, kernel);
+        if (options.path.compare("bits") == 0) {
+            rolling.recordPath();
+        }
+
+        if (filename.compare("") == 0) {
+            Index N = 0; // level count
+            if (prompt != NULL) {
+                *prompt << "Please enter the level count of pyramid: ";
+            }
+            input >> N;
+
+            readInput(N, input, prompt, rolling, admit);
+        } else if (filename.compare("-") == 0) {
+            readInput(input, rolling, admit);
+        } else {
+            std::ifstream inFile;
+
+            inFile.open(filename);
+
+            if (!inFile) {
+                fail(result, "Can not open input file.");
+                return;
+            }
+
+            std::string error;
+            if (options.path.compare("checkpoint") == 0) {
+                if (readCheckpointed(inFile, rolling, admit, cells, error) == false) {
+                    fail(result, error);
+                    return;
+                }
+            } else {
+                readInput(inFile, rolling, admit);
+            }
+
+            inFile.close();
+        }
+
+        if (options.path.compare("") != 0 && levelsFit<Index>(rolling.lastLevel) == false) {
+            fail(result, tooManyLevels<Index>(rolling.lastLevel)); // cells of the path can not be numbered
+            return;
+        }
+        if (options.path.compare("checkpoint") != 0) {
+            rolling.path(cells);
+        }
+
+        answer.value = format(rolling.result());
+        answer.path = toPath(cells);
+        result.answers.push_back(answer);
+        return;
+    }
+
+    Pyramid<Index, Weight> * pyramid = NULL;
+    std::string error;
+
+
+    if (filename.compare("") == 0) {
+        Index N = 0; // level count
+        if (prompt != NULL) {
+            *prompt << "Please enter the level count of pyramid: ";
+        }
+        input >> N;
+
+        readInput(N, input, prompt, pyramid, admit, error);
+    } else if (filename.compare("-") == 0) {
+        readInput(input, pyramid, error);
+    } else if (options.reader.compare("mmap") == 0 && readMapped(filename.c_str(), pyramid, error) == true) {
+        // mapped and parsed
+    } else {
+        std::ifstream inFile;
+
+        inFile.open(filename);
+
+        if (!inFile) {
+            fail(result, "Can not open input file.");
+            return;
+        }
+
+        readInput(inFile, pyramid, error);
+
+        inFile.close();
+    }
+
+    if (error.compare("") != 0) {
+        fail(result, error);
+        delete pyramid;
+        return;
+    }
+
+    pyramid->classify(admit);
+
+    if (options.updates > 0) {
+        benchmarkUpdates(pyramid, semiring, admit, options.updates, result);
+        delete pyramid;
+        return;
+    }
+
+    if (engine.compare("dag") == 0 && edgesFit<Index>(pyramid->levelCount) == false) {
+        fail(result, "Pyramid of " + std::to_string(pyramid->levelCount) + " levels has too many edges for "
+             + (sizeof(Index) < 8 ? "32-bit indices, it needs --index-bits=64." : "64-bit indices."));
+    } else if (engine.compare("dag") == 0) {
+        DAG<Index, Weight> * dag = NULL;
+        buildDAG(*pyramid, dag, semiring.neutral());
+        bool path = options.path.compare("") != 0;
+        answer.value = format(dag->maximumSum(semiring, path == true ? &cells : NULL));
+        // vertex v is cell v-1, the stop node is left out
+        if (cells.empty() == false && cells.back() == dag->vertexAmount - 1) {
+            cells.pop_back();
+        }
+        for (size_t k = 0; k < cells.size(); k++) {
+            cells[k]--;
+        }
+        answer.path = toPath(cells);
+        result.answers.push_back(answer);
+        delete dag;
+    } else {
+        answerImplicit(options, semiring, kernel, pyramid, pool, result);
+    }
+
+    delete pyramid;
+}
+
+} // namespace
+
+struct Context {
+    // Engine of one width, semiring and predicate, kept by a Solver between pyramids
+    virtual ~Context() {}
+    virtual void solve(const char *text, size_t length, Result& result) = 0;
+    virtual void solve(const long long *numbers, long long levelCount, Result& result) = 0;
+    virtual void solve(const char *const *texts, const size_t *lengths, size_t count, Result *results) = 0;
+};
+
+namespace {
+
+template <class Index, class S, class Admit>
+struct PyramidContext : Context {
+    typedef typename S::Number Weight;
+
+    Options options;
+    S semiring;
+    Admit admit;
+    LevelKernel<Index, S> kernel; // selected by ContextVisitor
+    LevelPool<Index, S> levelPool; // threads wait for the levels of the next pyramid
+    LevelPool<Index, S> *pool; // NULL for a single thread
+    Pyramid<Index, Weight> pyramid; // cells and admissible keep their allocations
+    std::vector<Pyramid<Index, Weight> *> group; // pyramids of the last grouped solve, kept the same way
+    LaneSum<Index, S> lanes;
+
+    PyramidContext(const Options& options, const S& semiring, Admit admit, const LevelKernel<Index, S>& kernel);
+    ~PyramidContext();
+
+    void solve(const char *text, size_t length, Result& result);
+    void solve(const long long *numbers, long long levelCount, Result& result);
+    void solve(const char *const *texts, const size_t *lengths, size_t count, Result *results);
+    void answer(Result& result);
+};
+
+template <class Index, class S, class Admit>
+PyramidContext<Index, S, Admit>::PyramidContext(const Options& options, const S& semiring, Admit admit,
+                                                const LevelKernel<Index, S>& kernel)
+    : options(options), semiring(semiring), admit(admit), kernel(kernel), levelPool(threadCount(options), kernel),
+      pyramid(0), lanes(semiring, kernel) {
+    this->pool = this->levelPool.threadCount > 1 ? &this->levelPool : NULL;
+}
+
+template <class Index, class S, class Admit>
+PyramidContext<Index, S, Admit>::~PyramidContext() {
+    for (size_t k = 0; k < group.size(); k++) {
+        delete group[k];
+    }
+}
+
+template <class Index, class S, class Admit>
+void PyramidContext<Index, S, Admit>::solve(const char *text, size_t length, Result& result)
+{
+    std::string error;
+    this->pyramid.clear();
+    if (readText(text, text + length, &this->pyramid, error) == false) {
+        fail(result, error);
+        return;
+    }
+    this->answer(result);
+}
+
+template <class Index, class S, class Admit>
+void PyramidContext<Index, S, Admit>::solve(const long long *numbers, long long levelCount, Result& result)
+{
+    this->pyramid.clear();
+    if (levelsFit<Index>(levelCount) == false) {
+        fail(result, tooManyLevels<Index>(levelCount));
+        return;
+    }
+    long long NSum = levelCount * (levelCount + 1) / 2;
+    Weight batch[4096]; // converted to the weight width in batches
+    for (long long i = 0; i < NSum; i += 4096) {
+        long long count = NSum - i < 4096 ? NSum - i : 4096;
+        for (long long k = 0; k < count; k++) {
+            batch[k] = (Weight) numbers[i + k];
+        }
+        this->pyramid.append(batch, (Index) count);
+    }
+    this->pyramid.resize((Index) levelCount);
+    this->answer(result);
+}
+
+template <class Index, class S, class Admit>
+void PyramidContext<Index, S, Admit>::solve(const char *const *texts, const size_t *lengths, size_t count,
+                                            Result *results)
+{
+    // Runs of up to LANES pyramids with the same level count share the vector lanes
+    if (this->options.lanes == false) {
+        for (size_t k = 0; k < count; k++) {
+            this->solve(texts[k], lengths[k], results[k]);
+        }
+        return;
+    }
+
+    while (this->group.size() < count) {
+        this->group.push_back(new Pyramid<Index, Weight>(0));
+    }
+    std::string error;
+    for (size_t k = 0; k < count; k++) {
+        this->group[k]->clear();
+        results[k].label = this->semiring.label();
+        if (readText(texts[k], texts[k] + lengths[k], this->group[k], error) == false) {
+            fail(results[k], error);
+            continue;
+        }
+        this->group[k]->classify(this->admit);
+    }
+
+    typename S::Value values[LANES];
+    for (size_t k = 0; k < count; ) {
+        if (results[k].status != 0) {
+            k++;
+            continue;
+        }
+        size_t n = 1;
+        while (k + n < count && n < (size_t) LANES && results[k + n].status == 0 &&
+               this->group[k + n]->levelCount == this->group[k]->levelCount) {
+            n++;
+        }
+        if (n == 1) {
+            answerImplicit(this->options, this->semiring, this->kernel, this->group[k], this->pool, results[k]);
+        } else {
+            this->lanes.solve(&this->group[k], (int) n, values);
+            for (size_t l = 0; l < n; l++) {
+                Answer answer;
+                answer.value = format(values[l]);
+                results[k + l].answers.push_back(answer);
+            }
+        }
+        k += n;
+    }
+}
+
+template <class Index, class S, class Admit>
+void PyramidContext<Index, S, Admit>::answer(Result& result)
+{
+    result.label = this->semiring.label();
+    this->pyramid.classify(this->admit);
+    answerImplicit(this->options, this->semiring, this->kernel, &this->pyramid, this->pool, result);
+}
+
+const char *parseBound(const char *text, long long& bound) {
+    // Returns where the number at the start of text ends, NULL if there is none or it does not fit
+    char *end = NULL;
+    errno = 0;
+    bound = strtoll(text, &end, 10);
+    return end == text || errno == ERANGE ? NULL : end;
+}
+
+bool parseDivisor(const std::string& admit, long long& divisor) {
+    // "divisible:K", K must not be zero
+    const char *end = parseBound(admit.c_str() + 10, divisor);
+    return end != NULL && *end == '\0' && divisor != 0;
+}
+
+bool parseRange(const std::string& admit, long long& low, long long& high) {
+    // "range:LOW:HIGH", or "range:LOW" without an upper bound
+    const char *end = parseBound(admit.c_str() + 6, low);
+    high = LLONG_MAX;
+    if (end != NULL && *end == ':') {
+        end = parseBound(end + 1, high);
+    }
+    return end != NULL && *end == '\0' && low <= high;
+}
+
+template <class Index, class S, class Visitor>
+void dispatchAdmit(const Options& options, const S& semiring, PrimeSieve *sieve, Visitor& visitor) {
+    // each predicate is inlined into its own classification loop
+    std::string admit = options.admit;
+    if (admit.compare("composite") == 0) {
+        visitor.template run<Index>(semiring, Composite(sieve));
+    } else if (admit.compare(0, 10, "divisible:") == 0) {
+        long long divisor = 1;
+        parseDivisor(admit, divisor);
+        visitor.template run<Index>(semiring, DivisibleBy(divisor));
+    } else if (admit.compare(0, 6, "range:") == 0) {
+        long long low = 0, high = 0;
+        parseRange(admit, low, high);
+        visitor.template run<Index>(semiring, ValueRange(low, high));
+    } else {
+        visitor.template run<Index>(semiring, NotPrime(sieve));
+    }
+}
+
+template <class Index, class Weight, class Visitor>
+void dispatchSemiring(const Options& options, PrimeSieve *sieve, Visitor& visitor) {
+    // each semiring gets its own instantiation of the solvers
+    if (options.semiring.compare("min-plus") == 0) {
+        dispatchAdmit<Index>(options, MinPlus<Weight>(), sieve, visitor);
+    } else if (options.semiring.compare("count") == 0) {
+        dispatchAdmit<Index>(options, PathCount<Weight>(), sieve, visitor);
+    } else if (options.semiring.compare("bottleneck") == 0) {
+        dispatchAdmit<Index>(options, Bottleneck<Weight>(), sieve, visitor);
+    } else if (options.semiring.compare("max-count") == 0 && options.modulus != 0) {
+        dispatchAdmit<Index>(options, CountedMaxPlus<Weight, unsigned long long>(options.modulus), sieve, visitor);
+    } else if (options.semiring.compare("max-count") == 0) {
+#ifdef __SIZEOF_INT128__
+        dispatchAdmit<Index>(options, CountedMaxPlus<Weight, uint128>(), sieve, visitor); // exact below 2^128
+#else
+        dispatchAdmit<Index>(options, CountedMaxPlus<Weight, unsigned long long>(), sieve, visitor);
+#endif
+    } else {
+        dispatchAdmit<Index>(options, MaxPlus<Weight>(), sieve, visitor);
+    }
+}
+
+template <class Visitor>
+void dispatch(const Options& options, PrimeSieve *sieve, Visitor& visitor) {
+    // Calls visitor.run<Index>(semiring, admit) with the types the options ask for
+    if (options.indexBits == 32 && options.weightBits == 32) {
+        dispatchSemiring<int, int>(options, sieve, visitor);
+    } else if (options.indexBits == 32) {
+        dispatchSemiring<int, long long>(options, sieve, visitor);
+    } else if (options.weightBits == 32) {
+        dispatchSemiring<long long, int>(options, sieve, visitor);
+    } else {
+        dispatchSemiring<long long, long long>(options, sieve, visitor);
+    }
+}
+
+struct SolveVisitor {
+    const Options *options;
+    std::istream *input;
+    std::ostream *prompt;
+    Result *result;
+
+    template <class Index, class S, class Admit>
+    void run(const S& semiring, Admit admit) {
+        solve<Index>(*options, semiring, admit, *input, prompt, *result);
+    }
+};
+
+struct ContextVisitor {
+    const Options *options;
+    Context *context; // NULL if the kernel is not supported
+
+    template <class Index, class S, class Admit>
+    void run(const S& semiring, Admit admit) {
+        LevelKernel<Index, S> kernel;
+        if (kernel.select(options->kernel) == true) {
+            context = new PyramidContext<Index, S, Admit>(*options, semiring, admit, kernel);
+        }
+    }
+};
+
+} // namespace
+
+std::string validate(const Options& options)
+{
+    std::string engine = options.engine;
+    if (engine.compare("implicit") != 0 && engine.compare("rolling") != 0 &&
+        engine.compare("stream") != 0 && engine.compare("dag") != 0) {
+        return "Unknown engine " + engine + ".";
+    }
+    if (options.reader.compare("mmap") != 0 && options.reader.compare("stream") != 0) {
+        return "Unknown reader " + options.reader + ".";
+    }
+    if (options.semiring.compare("max-plus") != 0 && options.semiring.compare("min-plus") != 0 &&
+        options.semiring.compare("count") != 0 && options.semiring.compare("bottleneck") != 0 &&
+        options.semiring.compare("max-count") != 0) {
+        return "Unknown semiring " + options.semiring + ".";
+    }
+    if (options.path.compare("") != 0 && options.path.compare("bits") != 0 && options.path.compare("checkpoint") != 0) {
+        return "Unknown path mode " + options.path + ".";
+    }
+    bool counting = options.semiring.compare("count") == 0 || options.semiring.compare("max-count") == 0;
+    if (options.path.compare("") != 0 && counting == true) {
+        return "Paths can not be recovered for semiring " + options.semiring + ", it does not choose between parents.";
+    }
+    if (options.top != 0 && (options.top < 0 || engine.compare("implicit") != 0 || counting == true)) {
+        return "Top sums need a positive count, the implicit engine and a semiring that chooses between parents.";
+    }
+    if (options.updates != 0 && (options.updates < 0 || engine.compare("implicit") != 0)) {
+        return "Update benchmarks need a positive count and the implicit engine.";
+    }
+    if (options.lanes == true && (options.path.compare("") != 0 || options.top != 0)) {
+        return "Vector lanes hold sums only, not paths or top sums.";
+    }
+    if (options.path.compare("checkpoint") == 0 &&
+        (engine.compare("rolling") != 0 || options.filename.compare("") == 0 || options.filename.compare("-") == 0)) {
+        return "Checkpointed paths need the rolling engine and an input file to read again.";
+    }
+    long long low = 0, high = 0;
+    if (options.admit.compare("not-prime") != 0 && options.admit.compare("composite") != 0 &&
+        (options.admit.compare(0, 10, "divisible:") != 0 || parseDivisor(options.admit, low) == false) &&
+        (options.admit.compare(0, 6, "range:") != 0 || parseRange(options.admit, low, high) == false)) {
+        return "Unknown admission predicate " + options.admit + ".";
+    }
+    if (options.modulus == 1) {
+        return "Modulus must be at least 2, or 0 for exact counts.";
+    }
+    if ((options.indexBits != 32 && options.indexBits != 64) ||
+        (options.weightBits != 32 && options.weightBits != 64)) {
+        return "Index and weight bits must be 32 or 64.";
+    }
+    return "";
+}
+
+std::string formatPath(const std::vector<Cell>& path)
+{
+    std::ostringstream out;
+    for (size_t i = 0; i < path.size(); i++) {
+        out << (i > 0 ? " " : "") << path[i].level << ',' << path[i].number;
+    }
+    return out.str();
+}
+
+Result solve(const Options& options, std::istream& input, std::ostream *prompt)
+{
+    Result result;
+    std::string error = validate(options);
+    if (error.compare("") == 0 && options.lanes == true) {
+        error = "Vector lanes solve batches of pyramids, not a single one.";
+    }
+    if (error.compare("") != 0) {
+        fail(result, error);
+        return result;
+    }
+
+    PrimeSieve sieve(options.sieveLimit);
+    SolveVisitor visitor = {&options, &input, prompt, &result};
+    dispatch(options, &sieve, visitor);
+    return result;
+}
+
+Solver::Solver(const Options& options) : Solver(options, NULL) {}
+
+Solver::Solver(const Options& options, PrimeSieve *sieve) {
+    this->error = validate(options);
+    this->sieve = sieve;
+    this->ownsSieve = false;
+    this->context = NULL;
+    if (this->error.compare("") == 0 && (options.engine.compare("implicit") != 0 || options.updates != 0)) {
+        this->error = "A solver keeps the implicit engine and does not benchmark updates.";
+    }
+    if (this->error.compare("") != 0) {
+        return;
+    }
+
+    if (this->sieve == NULL) {
+        this->sieve = new PrimeSieve(options.sieveLimit);
+        this->ownsSieve = true;
+    }
+    ContextVisitor visitor = {&options, NULL};
+    dispatch(options, this->sieve, visitor);
+    this->context = visitor.context;
+    if (this->context == NULL) {
+        this->error = "Kernel " + options.kernel + " is unknown or not supported for this CPU and semiring.";
+    }
+}
+
+Solver::~Solver() {
+    delete context;
+    if (this->ownsSieve == true) {
+        delete sieve;
+    }
+}
+
+Result Solver::solve(const char *text, size_t length)
+{
+    Result result;
+    if (this->context == NULL) {
+        fail(result, this->error);
+    } else {
+        this->context->solve(text, length, result);
+    }
+    return result;
+}
+
+void Solver::solve(const char *const *texts, const size_t *lengths, size_t count, Result *results)
+{
+    if (this->context == NULL) {
+        for (size_t k = 0; k < count; k++) {
+            fail(results[k], this->error);
+        }
+    } else {
+        this->context->solve(texts, lengths, count, results);
+    }
+}
+
+Result Solver::solve(const long long *numbers, long long levelCount)
+{
+    Result result;
+    if (this->context == NULL) {
+        fail(result, this->error);
+    } else if (levelCount < 0) {
+        fail(result, "Level count can not be negative.");
+    } else {
+        this->context->solve(numbers, levelCount, result);
+    }
+    return result;
+}
+
+} // namespace maxsum
@@ -0,0 +1,89 @@
+#ifndef MAXSUM_MAXSUM_H
+#define MAXSUM_MAXSUM_H
+
+#include <cstddef> // NULL
+#include <istream> // istream
+#include <ostream> // ostream
+#include <string> // string
+#include <vector> // STL Vector
+
+/*
+ * Library interface of the pyramid solvers.
+ * solve() reads a pyramid, solves it and returns the answer instead of printing it,
+ * so a service can call it once per query without spawning the command line.
+ * A Solver goes further for a stream of pyramids: it keeps the sieved primes,
+ * the level threads and the pyramid buffers between them.
+ * The engines themselves (DAG, Pyramid, RollingSum, ...) are templates in the other
+ * headers of this directory and can be used directly for a fixed width and semiring.
+ */
+
+namespace maxsum {
+
+struct Options {
+    std::string filename; // "" to read interactively from input, "-" to read a whole pyramid from input
+    std::string engine; // "implicit", "rolling", "stream" or "dag"
+    std::string reader; // "mmap" or "stream", for the implicit and dag engines
+    std::string kernel; // "auto", "avx2" or "scalar"
+    int sieveLimit; // primes up to it are sieved, larger ones checked with Miller-Rabin
+    std::string admit; // "not-prime", "composite", "divisible:K" or "range:LOW:HIGH"
+    int threads; // threads relaxing wide levels, 0 for one per core
+    int indexBits; // width of vertex numbers and counts, 32 or 64
+    int weightBits; // width of numbers and sums, 32 or 64, sums that do not fit wrap around and engines may then disagree
+    std::string semiring; // "max-plus", "min-plus", "count", "bottleneck" or "max-count"
+    unsigned long long modulus; // counts of "max-count" are modulo it, 0 for exact counts
+    std::string path; // "bits" or "checkpoint" to recover the path the answer comes from, "" not to
+    long long top; // count of best sums returned with their paths, 0 for the answer only
+    long long updates; // random single-number updates to time against a full solve, 0 for none
+    bool lanes; // Solver solves runs of pyramids with the same level count side by side in vector lanes
+
+    Options(); // same defaults as the command line
+};
+
+struct Cell {
+    long long level; // 1-based
+    long long number; // 1-based, within the level
+};
+
+struct Answer {
+    std::string value; // Eg: "1234", or "1234 (2 of 16 paths)" for max-count
+    std::vector<Cell> path; // top-most level first, empty if not asked for or if nothing is reachable
+};
+
+struct Result {
+    int status; // 0 on success, 1 otherwise like the exit code of the command line
+    std::string error; // why it failed
+    std::string label; // Eg: "Maximum Sum"
+    std::vector<Answer> answers; // the answer, or the best sums with top
+    double updateMicros; // average time of an incremental update, with updates
+    double fullMicros; // time of a full solve, with updates
+
+    Result();
+};
+
+std::string validate(const Options& options); // why options are invalid, "" if they are valid
+std::string formatPath(const std::vector<Cell>& path); // Eg: "1,1 2,2 3,2"
+Result solve(const Options& options, std::istream& input, std::ostream *prompt = NULL); // input is read for filenames "" and "-"
+
+struct PrimeSieve;
+struct Context; // engine of the width, semiring and predicate of the options, defined in maxsum.cpp
+
+struct Solver {
+    std::string error; // why the options can not be solved, "" if they can
+    PrimeSieve *sieve; // primes sieved for a pyramid stay for the next ones
+    bool ownsSieve; // false if the sieve is shared with other solvers
+    Context *context; // level threads and pyramid buffers, NULL on error
+
+    Solver(const Options& options); // needs the implicit engine and no updates, the filename is ignored
+    Solver(const Options& options, PrimeSieve *sieve); // shares sieve (up to options.sieveLimit) with other threads, it must outlive the solver
+    ~Solver();
+    Solver(const Solver&) = delete; // owns the context
+    Solver& operator=(const Solver&) = delete;
+
+    Result solve(const char *text, size_t length); // a pyramid in the format of the input files
+    Result solve(const long long *numbers, long long levelCount); // level by level, level i has i numbers
+    void solve(const char *const *texts, const size_t *lengths, size_t count, Result *results); // many at once
+};
+
+} // namespace maxsum
+
+#endif // MAXSUM_MAXSUM_H
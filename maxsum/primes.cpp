@@ -0,0 +1,213 @@
+#include <algorithm> // copy
+#include <vector> // STL Vector
+
+#include "primes.h"
+
+namespace maxsum {
+
+#ifdef __SIZEOF_INT128__
+Montgomery::Montgomery(unsigned long long n) {
+    this->n = n;
+    unsigned long long inverse = n; // correct to 3 bits, each step doubles them
+    for (int i = 0; i < 5; i++) {
+        inverse *= 2 - n * inverse;
+    }
+    this->negInverse = 0 - inverse;
+    unsigned long long r = (0 - n) % n; // 2^64 mod n
+    this->r2 = (unsigned long long) ((uint128) r * r % n);
+}
+
+unsigned long long Montgomery::reduce(uint128 t) const
+{
+    // t < n^2 < 2^126, so t + m*n does not overflow
+    unsigned long long m = (unsigned long long) t * negInverse;
+    unsigned long long u = (unsigned long long) ((t + (uint128) m * n) >> 64);
+    return u >= n ? u - n : u;
+}
+
+unsigned long long Montgomery::multiply(unsigned long long a, unsigned long long b) const
+{
+    return reduce((uint128) a * b);
+}
+
+unsigned long long Montgomery::convert(unsigned long long a) const
+{
+    return reduce((uint128) (a % n) * r2);
+}
+
+bool millerRabin(unsigned long long num)
+{
+    // Time Complexity: O(log n) per base, deterministic for every num below 2^64
+    static const unsigned long long SMALL_BASES[] = { 2, 7, 61 }; // enough below 4759123141
+    static const unsigned long long LARGE_BASES[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+    const unsigned long long *bases = num < 4759123141ULL ? SMALL_BASES : LARGE_BASES;
+    int baseCount = num < 4759123141ULL ? 3 : 7;
+
+    Montgomery mont(num);
+    unsigned long long d = num - 1;
+    int s = 0;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+    unsigned long long one = mont.convert(1);
+    unsigned long long minusOne = mont.convert(num - 1);
+
+    for (int i = 0; i < baseCount; i++) {
+        unsigned long long a = bases[i] % num;
+        if (a == 0) {
+            continue;
+        }
+
+        // x = a^d
+        unsigned long long x = one;
+        unsigned long long power = mont.convert(a);
+        for (unsigned long long e = d; e > 0; e >>= 1) {
+            if (e & 1) {
+                x = mont.multiply(x, power);
+            }
+            power = mont.multiply(power, power);
+        }
+
+        if (x == one || x == minusOne) {
+            continue;
+        }
+        bool witness = true;
+        for (int r = 1; r < s && witness; r++) {
+            x = mont.multiply(x, x);
+            witness = x != minusOne;
+        }
+        if (witness == true) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+bool isPrime(long long num)
+{
+    // Time Complexity: O(sqrt(n)) below 2^16, O(log n) above with Miller-Rabin
+    if (num <= 1) {
+        return false;
+    }
+    if (num <= 3) {
+        return true;
+    }
+
+    if (num % 2 == 0 || num % 3 == 0) {
+        return false;
+    }
+
+#ifdef __SIZEOF_INT128__
+    if (num >= (1 << 16)) {
+        return millerRabin((unsigned long long) num);
+    }
+#endif
+
+    for (long long i = 5; i * i <= num; i += 6) {
+        if (num % i == 0 || num % (i + 2) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+PrimeSieve::PrimeSieve(int maxLimit) {
+    this->maxLimit = maxLimit;
+    SieveBits *first = new SieveBits;
+    first->limit = 1;
+    first->bits = new unsigned long long[1];
+    first->bits[0] = 1; // 1 is not prime
+    this->arrays.push_back(first);
+    this->sieved.store(first, std::memory_order_release);
+}
+
+PrimeSieve::~PrimeSieve() {
+    for (size_t k = 0; k < this->arrays.size(); k++) {
+        delete [] this->arrays[k]->bits;
+        delete this->arrays[k];
+    }
+}
+
+void PrimeSieve::extend(int newLimit)
+{
+    // Time Complexity: O(n log log n), sieved in segments that fit in the cache
+    std::lock_guard<std::mutex> guard(this->lock);
+    const SieveBits *current = this->sieved.load(std::memory_order_acquire);
+    if (newLimit > this->maxLimit) {
+        newLimit = this->maxLimit;
+    }
+    if (newLimit <= current->limit) {
+        return; // another thread sieved it already
+    }
+
+    int wordCount = (int) ((current->limit / 2) / 64 + 1);
+    int newWordCount = (int) ((newLimit / 2) / 64 + 1);
+    SieveBits *next = new SieveBits;
+    next->limit = newLimit;
+    next->bits = new unsigned long long[newWordCount] ();
+    std::copy(current->bits, current->bits + wordCount, next->bits);
+    unsigned long long *bits = next->bits;
+
+    // odd primes up to sqrt(newLimit) cross out the rest
+    int root = 1;
+    while ((long long) (root + 1) * (root + 1) <= newLimit) {
+        root++;
+    }
+    std::vector<bool> composite(root + 1, false);
+    std::vector<int> primes;
+    for (int i = 3; i <= root; i += 2) {
+        if (composite[i] == false) {
+            primes.push_back(i);
+            for (int j = i * i; j <= root; j += 2 * i) {
+                composite[j] = true;
+            }
+        }
+    }
+
+    const long long SEGMENT = 1 << 18; // numbers per segment, 16 KB of bits
+    for (long long low = (long long) current->limit + 1; low <= newLimit; low += SEGMENT) {
+        long long high = low + SEGMENT - 1;
+        if (high > newLimit) {
+            high = newLimit;
+        }
+        for (size_t k = 0; k < primes.size(); k++) {
+            long long p = primes[k];
+            if (p * p > high) {
+                break;
+            }
+            long long start = (low + p - 1) / p * p;
+            if (start < p * p) {
+                start = p * p;
+            }
+            if (start % 2 == 0) {
+                start += p;
+            }
+            for (long long m = start; m <= high; m += 2 * p) {
+                bits[(m / 2) / 64] |= 1ULL << ((m / 2) % 64);
+            }
+        }
+    }
+    this->arrays.push_back(next);
+    this->sieved.store(next, std::memory_order_release);
+}
+
+bool PrimeSieve::isPrime(long long num) const
+{
+    // Time Complexity: O(1) up to limit, O(log n) above it
+    const SieveBits *current = this->sieved.load(std::memory_order_acquire);
+    if (num > current->limit) {
+        return maxsum::isPrime(num);
+    }
+    if (num < 2) {
+        return false;
+    }
+    if (num % 2 == 0) {
+        return num == 2;
+    }
+    return ((current->bits[(num / 2) / 64] >> ((num / 2) % 64)) & 1) == 0;
+}
+
+} // namespace maxsum
@@ -0,0 +1,139 @@
+#ifndef MAXSUM_PRIMES_H
+#define MAXSUM_PRIMES_H
+
+#include <atomic> // atomic
+#include <climits> // INT_MAX, LLONG_MIN
+#include <mutex> // mutex
+#include <vector> // STL Vector
+
+namespace maxsum {
+
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 uint128;
+
+struct Montgomery {
+    unsigned long long n; // odd modulus below 2^63
+    unsigned long long negInverse; // -n^-1 mod 2^64
+    unsigned long long r2; // 2^128 mod n, converts into Montgomery form
+
+    Montgomery(unsigned long long n);
+
+    unsigned long long reduce(uint128 t) const; // t * 2^-64 mod n
+    unsigned long long multiply(unsigned long long a, unsigned long long b) const;
+    unsigned long long convert(unsigned long long a) const;
+};
+
+bool millerRabin(unsigned long long num); // deterministic below 2^64
+#endif
+
+bool isPrime(long long num);
+
+struct SieveBits {
+    int limit; // numbers up to limit are answered from bits
+    unsigned long long *bits; // bit k is set if 2k+1 is not prime
+};
+
+struct PrimeSieve {
+    // Can be shared between threads: extend() copies the bits into a larger array, sieves
+    // the rest and then publishes it, so the bits a lookup reads are never written again.
+    // The arrays replaced are kept until the sieve is deleted, at most as large as the last one
+    // since prepare() at least doubles the limit.
+    int maxLimit; // numbers above it are checked with isPrime (Miller-Rabin)
+    std::atomic<const SieveBits *> sieved; // the last array published
+    std::vector<SieveBits *> arrays; // every array published, guarded by lock
+    std::mutex lock; // one extend() at a time
+
+    PrimeSieve(int maxLimit);
+    ~PrimeSieve();
+    PrimeSieve(const PrimeSieve&) = delete; // owns the arrays
+    PrimeSieve& operator=(const PrimeSieve&) = delete;
+
+    int limit() const { return sieved.load(std::memory_order_acquire)->limit; }
+    void extend(int newLimit); // sieves (limit, newLimit], capped at maxLimit
+    template <class Index, class Weight>
+    void prepare(const Weight *cells, Index count); // extends up to the largest of cells
+    bool isPrime(long long num) const;
+};
+
+template <class Index, class Weight>
+void PrimeSieve::prepare(const Weight *cells, Index count)
+{
+    // Sieves up to the largest number first so that each prime check is a bit lookup
+    Weight largest = 0;
+    for (Index i = 0; i < count; i++) {
+        largest = cells[i] > largest ? cells[i] : largest;
+    }
+    int limit = this->limit();
+    if (largest > limit && limit < this->maxLimit) {
+        // grow geometrically, rows of a pyramid are classified one at a time
+        long long grown = 2LL * limit;
+        if (grown < (long long) largest) {
+            grown = (long long) largest;
+        }
+        this->extend(grown > INT_MAX ? INT_MAX : (int) grown);
+    }
+}
+
+/*
+ * Admission predicates decide which numbers a path may go through.
+ * prepare() sees a batch of numbers before they are admitted one by one,
+ * the simple ones compile to branch-free loops the compiler vectorizes.
+ */
+
+struct NotPrime {
+    PrimeSieve *sieve;
+
+    NotPrime(PrimeSieve *sieve) : sieve(sieve) {}
+
+    template <class Index, class Weight>
+    void prepare(const Weight *cells, Index count) { sieve->prepare(cells, count); }
+    template <class Weight>
+    bool operator()(Weight num) const { return sieve->isPrime(num) == false; }
+};
+
+struct Composite {
+    PrimeSieve *sieve;
+
+    Composite(PrimeSieve *sieve) : sieve(sieve) {}
+
+    template <class Index, class Weight>
+    void prepare(const Weight *cells, Index count) { sieve->prepare(cells, count); }
+    template <class Weight>
+    bool operator()(Weight num) const { return num > 3 && sieve->isPrime(num) == false; }
+};
+
+struct DivisibleBy {
+    long long divisor; // not negative unless LLONG_MIN, num % -1 traps for the smallest num
+
+    DivisibleBy(long long divisor) : divisor(divisor < 0 && divisor != LLONG_MIN ? -divisor : divisor) {}
+
+    template <class Index, class Weight>
+    void prepare(const Weight *, Index) {}
+    template <class Weight>
+    bool operator()(Weight num) const { return num % divisor == 0; }
+};
+
+struct ValueRange {
+    long long low;
+    long long high;
+
+    ValueRange(long long low, long long high) : low(low), high(high) {}
+
+    template <class Index, class Weight>
+    void prepare(const Weight *, Index) {}
+    template <class Weight>
+    bool operator()(Weight num) const { return (num >= low) & (num <= high); }
+};
+
+template <class Index, class Weight, class Admit>
+void classify(const Weight *cells, Index count, unsigned char *admissible, Admit& admit) {
+    // Time Complexity: O(count), the predicate is inlined into the loop
+    admit.prepare(cells, count);
+    for (Index i = 0; i < count; i++) {
+        admissible[i] = admit(cells[i]);
+    }
+}
+
+} // namespace maxsum
+
+#endif // MAXSUM_PRIMES_H
@@ -0,0 +1,843 @@
+#ifndef MAXSUM_PYRAMID_H
+#define MAXSUM_PYRAMID_H
+
+#include <algorithm> // copy, fill, reverse, partial_sort
+#include <limits> // numeric_limits
+#include <new> // nothrow
+#include <utility> // pair, make_pair
+#include <vector> // STL Vector
+
+#include "dag.h"
+#include "kernels.h"
+#include "primes.h"
+
+namespace maxsum {
+
+template <class Index>
+bool levelsFit(long long levelCount) {
+    // whether the numbers of a pyramid can be counted in Index: the level offsets
+    // i*(i-1)/2 and the count N*(N+1)/2 are computed in Index, so N*(N+1) must fit
+    const long long most = std::numeric_limits<Index>::max();
+    if (levelCount <= 0) {
+        return true;
+    }
+    if (levelCount >= most) {
+        return false;
+    }
+    return levelCount <= most / (levelCount + 1);
+}
+
+template <class Index>
+bool edgesFit(long long levelCount) {
+    // whether the DAG of a pyramid can be built with Index: it has at most
+    // 2*N*(N+1)/2 + N + 1 = (N+1)^2 edges, more than the numbers of levelsFit
+    const long long most = std::numeric_limits<Index>::max();
+    if (levelCount < 0) {
+        return true;
+    }
+    if (levelCount >= most) {
+        return false;
+    }
+    return levelCount + 1 <= most / (levelCount + 1);
+}
+
+template <class Index, class Reached>
+void answerNumbers(Index lastLevel, bool bottom, const Reached& reached, Index& first, Index& last) {
+    // Numbers [first, last] of lastLevel, the deepest level with a reachable number, that the
+    // answer is made of, as the DAG gives it: all of them if it is the bottom-most level (the stop
+    // node), otherwise the last reachable one. reached(j) tells whether number j (1-based) is.
+    // The range is empty (first > last) if lastLevel is 0.
+    first = 1;
+    last = lastLevel;
+    if (bottom == false) {
+        while (last >= 1 && reached(last) == false) {
+            last--;
+        }
+        first = last >= 1 ? last : 1;
+    }
+}
+
+template <class Index, class S, class Sums>
+typename S::Value answerValue(const S& semiring, Index lastLevel, bool bottom, const Sums& sums) {
+    // The answer over the numbers of answerNumbers, sums(j) being the sum of number j,
+    // one() if nothing is reachable
+    typedef typename S::Value Value;
+    const Value UNREACHABLE = semiring.zero();
+    Index first = 1, last = 0;
+    answerNumbers(lastLevel, bottom, [&sums, &UNREACHABLE](Index j) { return sums(j) != UNREACHABLE; }, first, last);
+    if (first > last) {
+        return semiring.one();
+    }
+    Value result = UNREACHABLE;
+    for (Index j = first; j <= last; j++) {
+        result = semiring.plus(result, sums(j));
+    }
+    return result;
+}
+
+template <class Index, class S>
+struct RollingSum {
+    typedef typename S::Number Weight;
+    typedef typename S::Value Value;
+
+    S semiring; // what is computed, MaxPlus for the maximum sum
+    Index levelCount; // count of levels added so far
+    Index lastLevel; // deepest level with a reachable number
+    Index capacity; // longest level prev and cur can hold
+    Value *prev; // sums of the last reachable level, zero() at both ends
+    Value *cur; // sums of the level being added
+    LevelPool<Index, S> *pool; // relaxes wide levels in parallel if not NULL
+    LevelKernel<Index, S> kernel; // relaxes the levels the pool does not
+    unsigned long long *choices; // one bit per number, set if reached from the right parent, NULL if not recorded
+    Index choiceCount; // words of choices used, each level starts at a new word
+    Index choiceCapacity; // allocated length of choices
+    Index recordedFrom; // first level with choices
+
+    RollingSum(Index capacity, LevelPool<Index, S> *pool = NULL, const S& semiring = S(),
+               const LevelKernel<Index, S>& kernel = LevelKernel<Index, S>());
+    ~RollingSum();
+
+    void resume(Index level, const Value *sums); // continue below level from its sums (level + 2 values)
+    void recordPath(); // choices are kept for the levels added from now on
+    void addLevel(const Weight *row, const unsigned char *admissible); // levelCount + 1 numbers
+    Value result() const;
+    Index resultNumber() const; // number of lastLevel (1-based) the result comes from, 0 if none
+    void path(std::vector<Index>& cells) const; // cell of each level on the path, row-major from 0
+    Index trace(Index number, std::vector<Index>& cells) const; // appends the cells from lastLevel upwards
+};
+
+template <class Index, class S>
+RollingSum<Index, S>::RollingSum(Index capacity, LevelPool<Index, S> *pool, const S& semiring,
+                                 const LevelKernel<Index, S>& kernel) {
+    this->semiring = semiring;
+    this->kernel = kernel;
+    this->levelCount = 0;
+    this->pool = pool;
+    this->lastLevel = 0;
+    this->capacity = capacity > 0 ? capacity : 1;
+    this->prev = new Value[this->capacity + 2];
+    this->cur = new Value[this->capacity + 2];
+    this->choices = NULL;
+    this->choiceCount = 0;
+    this->choiceCapacity = 0;
+    this->recordedFrom = 1;
+
+    // level 0 is the start (source) node
+    prev[0] = semiring.zero();
+    prev[1] = semiring.one();
+}
+
+template <class Index, class S>
+RollingSum<Index, S>::~RollingSum() {
+    delete [] prev;
+    delete [] cur;
+    delete [] choices;
+}
+
+template <class Index, class S>
+void RollingSum<Index, S>::resume(Index level, const Value *sums)
+{
+    if (level > this->capacity) {
+        delete [] this->prev;
+        delete [] this->cur;
+        this->prev = new Value[level + 2];
+        this->cur = new Value[level + 2];
+        this->capacity = level;
+    }
+    std::copy(sums, sums + level + 2, this->prev);
+    this->levelCount = level;
+    this->lastLevel = level;
+}
+
+template <class Index, class S>
+void RollingSum<Index, S>::recordPath()
+{
+    // level i takes (i + 63) / 64 words, enough up to capacity levels
+    // counted in long long, the product may not fit Index even if the words do
+    long long first = this->levelCount;
+    long long levels = this->capacity > first ? this->capacity : first;
+    this->choiceCapacity = (Index) ((levels * (levels + 1) - first * (first + 1)) / 128 + levels - first + 1);
+    delete [] this->choices;
+    this->choices = new unsigned long long[this->choiceCapacity];
+    this->choiceCount = 0;
+    this->recordedFrom = (Index) first + 1;
+}
+
+template <class Index, class S>
+void RollingSum<Index, S>::addLevel(const Weight *row, const unsigned char *admissible)
+{
+    // Time Complexity: O(i) for level i, only two levels are kept in memory
+    // The parents of level i, number j are level i-1, numbers j-1 and j.
+    // Both ends of a level hold zero() so that edge numbers have a single parent.
+    Index i = ++this->levelCount;
+    if (this->lastLevel + 1 != i) {
+        return; // an earlier level was not reachable, neither is this one
+    }
+
+    if (i > this->capacity) {
+        Value *temp = new Value[2 * i + 2];
+        std::copy(this->prev, this->prev + i + 1, temp);
+        delete [] this->prev;
+        delete [] this->cur;
+        this->prev = temp;
+        this->cur = new Value[2 * i + 2];
+        this->capacity = 2 * i;
+    }
+
+    Index words = (i + 63) / 64;
+    if (this->choices != NULL) {
+        if (this->choiceCount + words > this->choiceCapacity) {
+            Index newCapacity = 2 * (this->choiceCount + words);
+            unsigned long long *temp = new unsigned long long[newCapacity];
+            std::copy(this->choices, this->choices + this->choiceCount, temp);
+            delete [] this->choices;
+            this->choices = temp;
+            this->choiceCapacity = newCapacity;
+        }
+    }
+
+    // the kernel records the choice of each number while it relaxes the level
+    unsigned long long *bits = this->choices != NULL ? this->choices + this->choiceCount : NULL;
+    cur[0] = semiring.zero();
+    cur[i + 1] = semiring.zero();
+    bool reachable = this->pool != NULL ? this->pool->relax(semiring, prev, cur, row, admissible, i, bits)
+                                        : this->kernel.relax(semiring, prev, cur, row, admissible, i, bits);
+    if (reachable == true) {
+        Value *temp = prev;
+        prev = cur;
+        cur = temp;
+        this->lastLevel = i;
+        this->choiceCount += this->choices != NULL ? words : 0;
+    }
+}
+
+template <class Index, class S>
+typename S::Value RollingSum<Index, S>::result() const
+{
+    // Same answer as the DAG: the stop node if the bottom-most level is reached,
+    // otherwise the last reachable node in vertex order
+    return answerValue(semiring, lastLevel, lastLevel == levelCount, [this](Index j) { return this->prev[j]; });
+}
+
+template <class Index, class S>
+Index RollingSum<Index, S>::resultNumber() const
+{
+    // the first number the bottom-most level chooses, as the stop node of the DAG does
+    const Value UNREACHABLE = semiring.zero();
+    Index first = 1, last = 0;
+    answerNumbers(lastLevel, lastLevel == levelCount,
+                  [this, &UNREACHABLE](Index j) { return this->prev[j] != UNREACHABLE; }, first, last);
+    Value best = UNREACHABLE;
+    Index number = 0;
+    for (Index j = first; j <= last; j++) {
+        if (semiring.plus(best, prev[j]) != best) {
+            best = semiring.plus(best, prev[j]);
+            number = j;
+        }
+    }
+    return number;
+}
+
+template <class Index, class S>
+void RollingSum<Index, S>::path(std::vector<Index>& cells) const
+{
+    // Time Complexity: O(lastLevel), walks the recorded choices upwards
+    cells.clear();
+    Index j = this->resultNumber();
+    if (this->choices == NULL || j == 0) {
+        return;
+    }
+    this->trace(j, cells);
+    std::reverse(cells.begin(), cells.end());
+}
+
+template <class Index, class S>
+Index RollingSum<Index, S>::trace(Index number, std::vector<Index>& cells) const
+{
+    // Returns the number of the level above recordedFrom the path goes through
+    Index j = number;
+    Index word = this->choiceCount;
+    for (Index i = this->lastLevel; i >= this->recordedFrom; i--) {
+        word -= (i + 63) / 64; // first word of level i
+        cells.push_back(i * (i - 1) / 2 + j - 1);
+        bool right = (this->choices[word + (j - 1) / 64] >> ((j - 1) % 64)) & 1;
+        j = right == true ? j : j - 1;
+    }
+    return j;
+}
+
+template <class Index, class S>
+struct TopSums {
+    typedef typename S::Number Weight;
+    typedef typename S::Value Value;
+
+    S semiring; // must choose between parents, MaxPlus for the highest sums
+    Index K; // best sums kept for every number
+    Index levelCount; // count of levels added so far
+    Index lastLevel; // deepest level with a reachable number
+    Index capacity; // longest level prev and cur can hold
+    Value *prev; // K best sums of each number of the last reachable level, best first
+    Value *cur; // K best sums of each number of the level being added
+    Index *prevCount; // how many of the K sums of a number are used
+    Index *curCount;
+    Index *from; // for each cell and rank: 2 * rank in the parent, + 1 if from the right parent
+
+    TopSums(Index levelCount, Index K, const S& semiring = S());
+    ~TopSums();
+
+    static bool fits(Index levelCount, long long K); // whether the K sums of every number can be indexed by Index
+    bool allocated() const { return prev != NULL && cur != NULL && from != NULL; } // false if memory ran out
+
+    bool better(Value a, Value b) const { return semiring.plus(a, b) != b; }
+    void addLevel(const Weight *row, const unsigned char *admissible); // levelCount + 1 numbers
+    void path(Index number, Index rank, std::vector<Index>& cells) const; // from lastLevel upwards
+    void best(std::vector<Value>& sums, std::vector<std::vector<Index> >& paths) const; // up to K, best first
+};
+
+template <class Index, class S>
+struct TopOrder {
+    // best sum first, ties in number and rank order
+    const TopSums<Index, S> *top;
+
+    bool operator()(const std::pair<Index, Index>& a, const std::pair<Index, Index>& b) const {
+        typename S::Value sumA = top->prev[a.first * top->K + a.second];
+        typename S::Value sumB = top->prev[b.first * top->K + b.second];
+        if (top->better(sumA, sumB) || top->better(sumB, sumA)) {
+            return top->better(sumA, sumB);
+        }
+        return a < b;
+    }
+};
+
+template <class Index, class S>
+TopSums<Index, S>::TopSums(Index levelCount, Index K, const S& semiring) {
+    this->semiring = semiring;
+    this->K = K > 0 ? K : 1;
+    this->levelCount = 0;
+    this->lastLevel = 0;
+    this->capacity = levelCount > 0 ? levelCount : 1;
+    size_t cells = (size_t) this->capacity * ((size_t) this->capacity + 1) / 2; // sizes may not fit Index
+    this->prev = new (std::nothrow) Value[((size_t) this->capacity + 2) * (size_t) this->K];
+    this->cur = new (std::nothrow) Value[((size_t) this->capacity + 2) * (size_t) this->K];
+    this->prevCount = new Index[this->capacity + 2] ();
+    this->curCount = new Index[this->capacity + 2] ();
+    this->from = new (std::nothrow) Index[cells * (size_t) this->K];
+
+    // level 0 is the start (source) node
+    if (prev != NULL) {
+        prev[this->K] = semiring.one();
+    }
+    prevCount[1] = 1;
+}
+
+template <class Index, class S>
+TopSums<Index, S>::~TopSums() {
+    delete [] prev;
+    delete [] cur;
+    delete [] prevCount;
+    delete [] curCount;
+    delete [] from;
+}
+
+template <class Index, class S>
+bool TopSums<Index, S>::fits(Index levelCount, long long K)
+{
+    // K times a bound on the cells and on the numbers of a level with its two ends
+    const long long most = std::numeric_limits<Index>::max();
+    long long levels = levelCount > 0 ? levelCount : 1;
+    if (levelsFit<Index>(levels + 2) == false) {
+        return false;
+    }
+    return K <= most / ((levels + 2) * (levels + 3) / 2);
+}
+
+template <class Index, class S>
+void TopSums<Index, S>::addLevel(const Weight *row, const unsigned char *admissible)
+{
+    // Time Complexity: O(i * K) for level i, the sorted lists of both parents are merged
+    // and extended by the number, which keeps them sorted
+    Index i = ++this->levelCount;
+    if (this->lastLevel + 1 != i || i > this->capacity) {
+        return; // an earlier level was not reachable, neither is this one
+    }
+
+    bool reachable = false;
+    curCount[0] = 0;
+    curCount[i + 1] = 0;
+    for (Index j = 1; j <= i; j++) {
+        Index count = 0;
+        if (admissible[j - 1]) {
+            const Value *left = prev + (j - 1) * K;
+            const Value *right = prev + j * K;
+            Index leftCount = prevCount[j - 1], rightCount = prevCount[j];
+            Index l = 0, r = 0;
+            Index *back = from + (i * (i - 1) / 2 + j - 1) * K;
+            Value *sums = cur + j * K;
+            while (count < K && (l < leftCount || r < rightCount)) {
+                if (r == rightCount || (l < leftCount && better(right[r], left[l]) == false)) {
+                    sums[count] = semiring.times(left[l], row[j - 1]);
+                    back[count++] = 2 * l++;
+                } else {
+                    sums[count] = semiring.times(right[r], row[j - 1]);
+                    back[count++] = 2 * r++ + 1;
+                }
+            }
+        }
+        curCount[j] = count;
+        reachable = reachable || count > 0;
+    }
+
+    if (reachable == true) {
+        Value *temp = prev;
+        prev = cur;
+        cur = temp;
+        Index *tempCount = prevCount;
+        prevCount = curCount;
+        curCount = tempCount;
+        this->lastLevel = i;
+    }
+}
+
+template <class Index, class S>
+void TopSums<Index, S>::path(Index number, Index rank, std::vector<Index>& cells) const
+{
+    // Time Complexity: O(lastLevel)
+    cells.clear();
+    for (Index i = this->lastLevel; i >= 1; i--) {
+        Index cell = i * (i - 1) / 2 + number - 1;
+        cells.push_back(cell);
+        Index back = from[cell * K + rank];
+        rank = back / 2;
+        number = back % 2 == 1 ? number : number - 1;
+    }
+    std::reverse(cells.begin(), cells.end());
+}
+
+template <class Index, class S>
+void TopSums<Index, S>::best(std::vector<Value>& sums, std::vector<std::vector<Index> >& paths) const
+{
+    // Same numbers as RollingSum::result(): every number of the bottom-most level
+    // if it is reached, otherwise the last reachable number
+    std::vector<std::pair<Index, Index> > candidates; // number and rank
+    Index first = 1, last = 0;
+    answerNumbers(lastLevel, lastLevel == levelCount, [this](Index j) { return this->prevCount[j] > 0; }, first, last);
+    for (Index j = first; j <= last; j++) {
+        for (Index r = 0; r < prevCount[j]; r++) {
+            candidates.push_back(std::make_pair(j, r));
+        }
+    }
+
+    TopOrder<Index, S> order;
+    order.top = this;
+    Index shown = (Index) candidates.size() < K ? (Index) candidates.size() : K;
+    std::partial_sort(candidates.begin(), candidates.begin() + shown, candidates.end(), order);
+
+    sums.resize(shown);
+    paths.resize(shown);
+    for (Index k = 0; k < shown; k++) {
+        Index j = candidates[k].first, r = candidates[k].second;
+        sums[k] = prev[j * K + r];
+        this->path(j, r, paths[k]);
+    }
+}
+
+template <class Index, class Weight>
+struct Pyramid {
+    Index levelCount; // count of levels
+    Index cellCount; // count of numbers held in cells
+    Index capacity; // allocated length of cells
+    Weight *cells; // numbers in row-major order, level i (1-based) starts at index i*(i-1)/2
+    unsigned char *admissible; // whether a path may go through each number, set by classify()
+    Index admissibleCapacity; // allocated length of admissible
+
+    Pyramid(Index levelCount);
+    ~Pyramid();
+
+    void clear(); // empties the pyramid but keeps the allocations for the next one
+    bool append(const Weight *numbers, Index count); // grows cells as needed, false if they would not fit Index
+    bool resize(Index levelCount); // drops extra numbers, missing ones are zero, false if they do not fit Index
+    template <class Admit> void classify(Admit& admit);
+    template <class S> // works on the rows directly, no DAG is built, path is filled if not NULL
+    typename S::Value maximumSum(const S& semiring, LevelPool<Index, S> *pool = NULL, std::vector<Index> *path = NULL,
+                                 const LevelKernel<Index, S>& kernel = LevelKernel<Index, S>());
+    template <class S> // K best sums with their paths, false if there is not enough memory for them
+    bool topSums(const S& semiring, Index K, std::vector<typename S::Value>& sums, std::vector<std::vector<Index> >& paths);
+};
+
+template <class Index, class Weight>
+Pyramid<Index, Weight>::Pyramid(Index levelCount) {
+    this->levelCount = levelCount;
+    this->cellCount = levelCount * (levelCount + 1) / 2;
+    this->capacity = this->cellCount > 0 ? this->cellCount : 1;
+    this->cells = new Weight[this->capacity] ();
+    this->admissible = NULL;
+    this->admissibleCapacity = 0;
+}
+
+template <class Index, class Weight>
+Pyramid<Index, Weight>::~Pyramid() {
+    delete [] cells;
+    delete [] admissible;
+}
+
+template <class Index, class Weight>
+void Pyramid<Index, Weight>::clear()
+{
+    this->levelCount = 0;
+    this->cellCount = 0;
+}
+
+template <class Index, class Weight>
+bool Pyramid<Index, Weight>::append(const Weight *numbers, Index count)
+{
+    // Time Complexity: amortized O(count), capacities are computed in long long so they can not wrap
+    const long long most = std::numeric_limits<Index>::max();
+    long long needed = (long long) this->cellCount + count;
+    if (needed > most) {
+        return false; // unchanged
+    }
+    if (needed > this->capacity) {
+        long long newCapacity = this->capacity <= most / 2 ? 2 * (long long) this->capacity : most;
+        if (newCapacity < needed) {
+            newCapacity = needed;
+        }
+        Weight *temp = new Weight[newCapacity];
+        std::copy(this->cells, this->cells + this->cellCount, temp);
+        delete [] this->cells;
+        this->cells = temp;
+        this->capacity = (Index) newCapacity;
+    }
+    std::copy(numbers, numbers + count, this->cells + this->cellCount);
+    this->cellCount += count;
+    return true;
+}
+
+template <class Index, class Weight>
+bool Pyramid<Index, Weight>::resize(Index levelCount)
+{
+    if (levelsFit<Index>(levelCount) == false) {
+        return false; // unchanged
+    }
+    Index NSum = levelCount * (levelCount + 1) / 2;
+    if (NSum > this->cellCount) {
+        Weight *zeros = new Weight[NSum - this->cellCount] ();
+        this->append(zeros, NSum - this->cellCount);
+        delete [] zeros;
+    }
+    this->cellCount = NSum;
+    this->levelCount = levelCount;
+    return true;
+}
+
+template <class Index, class Weight>
+template <class Admit>
+void Pyramid<Index, Weight>::classify(Admit& admit)
+{
+    if (this->admissible == NULL || this->admissibleCapacity < this->cellCount) {
+        delete [] this->admissible;
+        this->admissibleCapacity = this->capacity;
+        this->admissible = new unsigned char[this->admissibleCapacity];
+    }
+    maxsum::classify(this->cells, this->cellCount, this->admissible, admit);
+}
+
+template <class Index, class Weight>
+template <class S>
+typename S::Value Pyramid<Index, Weight>::maximumSum(const S& semiring, LevelPool<Index, S> *pool,
+                                                     std::vector<Index> *path, const LevelKernel<Index, S>& kernel)
+{
+    // Time Complexity: O(V) where V are the cells, no edges are stored
+    RollingSum<Index, S> rolling(this->levelCount, pool, semiring, kernel);
+    if (path != NULL) {
+        rolling.recordPath(); // one bit per cell
+    }
+
+    for (Index i = 1; i <= this->levelCount; i++) {
+        rolling.addLevel(this->cells + i * (i - 1) / 2, this->admissible + i * (i - 1) / 2);
+        if (rolling.lastLevel != i) {
+            break; // nothing below is reachable
+        }
+    }
+
+    if (path != NULL) {
+        rolling.path(*path);
+    }
+    return rolling.result();
+}
+
+template <class Index, class Weight>
+template <class S>
+bool Pyramid<Index, Weight>::topSums(const S& semiring, Index K, std::vector<typename S::Value>& sums,
+                                     std::vector<std::vector<Index> >& paths)
+{
+    // Time Complexity: O(V * K) where V are the cells, K back-pointers are kept for each
+    TopSums<Index, S> top(this->levelCount, K, semiring);
+    if (top.allocated() == false) {
+        return false;
+    }
+
+    for (Index i = 1; i <= this->levelCount; i++) {
+        top.addLevel(this->cells + i * (i - 1) / 2, this->admissible + i * (i - 1) / 2);
+        if (top.lastLevel != i) {
+            break; // nothing below is reachable
+        }
+    }
+
+    top.best(sums, paths);
+    return true;
+}
+
+template <class Index, class S>
+struct LaneSum {
+    // Up to LANES pyramids of the same height solved together, each in its own vector lane
+    typedef typename S::Number Weight;
+    typedef typename S::Value Value;
+
+    S semiring;
+    Index capacity; // cells of one pyramid the buffers hold
+    Index levelCapacity; // longest level prev and cur can hold
+    Weight *cells; // number j of lane l at j * LANES + l, row-major like Pyramid
+    unsigned char *admissible; // same layout, zero in unused lanes
+    Value *prev; // sums of the last level, zero() at both ends, same layout
+    Value *cur; // sums of the level being relaxed
+    LevelKernel<Index, S> kernel;
+
+    LaneSum(const S& semiring = S(), const LevelKernel<Index, S>& kernel = LevelKernel<Index, S>());
+    ~LaneSum();
+
+    void solve(Pyramid<Index, Weight> *const *pyramids, int count, Value *results); // classified pyramids
+    Value result(Index level, int lane, bool bottom) const; // answer of a lane whose last reachable level is in prev
+};
+
+template <class Index, class S>
+LaneSum<Index, S>::LaneSum(const S& semiring, const LevelKernel<Index, S>& kernel) {
+    this->semiring = semiring;
+    this->kernel = kernel;
+    this->capacity = 1;
+    this->levelCapacity = 1;
+    this->cells = new Weight[(size_t) this->capacity * LANES];
+    this->admissible = new unsigned char[(size_t) this->capacity * LANES];
+    this->prev = new Value[((size_t) this->levelCapacity + 2) * LANES];
+    this->cur = new Value[((size_t) this->levelCapacity + 2) * LANES];
+}
+
+template <class Index, class S>
+LaneSum<Index, S>::~LaneSum() {
+    delete [] cells;
+    delete [] admissible;
+    delete [] prev;
+    delete [] cur;
+}
+
+template <class Index, class S>
+void LaneSum<Index, S>::solve(Pyramid<Index, Weight> *const *pyramids, int count, Value *results)
+{
+    // Time Complexity: O(V * LANES) where V are the cells of one pyramid, a vector per number
+    Index N = pyramids[0]->levelCount;
+    Index NSum = pyramids[0]->cellCount;
+    if (NSum > this->capacity) {
+        delete [] this->cells;
+        delete [] this->admissible;
+        this->capacity = NSum;
+        this->cells = new Weight[(size_t) this->capacity * LANES];
+        this->admissible = new unsigned char[(size_t) this->capacity * LANES];
+    }
+    if (N > this->levelCapacity) {
+        delete [] this->prev;
+        delete [] this->cur;
+        this->levelCapacity = N;
+        this->prev = new Value[((size_t) this->levelCapacity + 2) * LANES];
+        this->cur = new Value[((size_t) this->levelCapacity + 2) * LANES];
+    }
+
+    // transpose into structure-of-arrays, unused lanes are never reachable
+    // offsets are LANES times those of a pyramid, which Index may not hold
+    for (int l = 0; l < LANES; l++) {
+        for (Index c = 0; c < NSum; c++) {
+            this->cells[(size_t) c * LANES + l] = l < count ? pyramids[l]->cells[c] : 0;
+            this->admissible[(size_t) c * LANES + l] = l < count ? pyramids[l]->admissible[c] : 0;
+        }
+    }
+
+    // level 0 is the start (source) node of every lane
+    std::fill(this->prev, this->prev + ((size_t) N + 2) * LANES, semiring.zero());
+    std::fill(this->cur, this->cur + ((size_t) N + 2) * LANES, semiring.zero());
+    std::fill(this->prev + LANES, this->prev + 2 * LANES, semiring.one());
+
+    unsigned alive = (1u << count) - 1; // lanes that reached the level above
+    for (Index i = 1; i <= N && alive != 0; i++) {
+        size_t first = (size_t) i * (i - 1) / 2 * LANES; // number 1 of level i in every lane
+        unsigned reachable = this->kernel.relaxLanes(semiring, this->prev, this->cur, this->cells + first,
+                                                     this->admissible + first, i);
+        for (int l = 0; l < count; l++) {
+            if ((alive & ~reachable) >> l & 1) {
+                results[l] = this->result(i - 1, l, false); // nothing below is reachable
+            }
+        }
+        alive &= reachable;
+        std::swap(this->prev, this->cur);
+    }
+
+    for (int l = 0; l < count; l++) {
+        if (alive >> l & 1) {
+            results[l] = this->result(N, l, true);
+        }
+    }
+}
+
+template <class Index, class S>
+typename S::Value LaneSum<Index, S>::result(Index level, int lane, bool bottom) const
+{
+    // Same answer as RollingSum::result
+    return answerValue(semiring, level, bottom,
+                       [this, lane](Index j) { return this->prev[(size_t) j * LANES + lane]; });
+}
+
+template <class Index, class S, class Admit>
+struct IncrementalSolver {
+    typedef typename S::Number Weight;
+    typedef typename S::Value Value;
+
+    S semiring; // what is computed, MaxPlus for the maximum sum
+    Admit admit; // classifies updated numbers
+    Pyramid<Index, Weight> *pyramid; // numbers and admissibility, classified by the caller
+    Value *sums; // sum of every cell, row-major like the numbers
+    Index *reached; // count of reachable numbers in each level (1-based)
+
+    IncrementalSolver(Pyramid<Index, Weight> *pyramid, const S& semiring, const Admit& admit);
+    ~IncrementalSolver();
+
+    Value relaxCell(Index i, Index j) const; // sum of level i, number j from the level above
+    void solveAll(); // full solve, O(V)
+    void updateCell(Index row, Index col, Weight value); // level and number are 1-based
+    Value result() const;
+};
+
+template <class Index, class S, class Admit>
+IncrementalSolver<Index, S, Admit>::IncrementalSolver(Pyramid<Index, Weight> *pyramid, const S& semiring,
+                                                      const Admit& admit) : semiring(semiring), admit(admit) {
+    this->pyramid = pyramid;
+    this->sums = new Value[pyramid->cellCount > 0 ? pyramid->cellCount : 1];
+    this->reached = new Index[pyramid->levelCount + 2] ();
+    this->solveAll();
+}
+
+template <class Index, class S, class Admit>
+IncrementalSolver<Index, S, Admit>::~IncrementalSolver() {
+    delete [] sums;
+    delete [] reached;
+}
+
+template <class Index, class S, class Admit>
+typename S::Value IncrementalSolver<Index, S, Admit>::relaxCell(Index i, Index j) const
+{
+    // the parents of level i, number j are level i-1, numbers j-1 and j
+    Index cell = i * (i - 1) / 2 + j - 1;
+    Value parent = semiring.one();
+    if (i > 1) {
+        Index above = (i - 1) * (i - 2) / 2 + j - 1;
+        parent = semiring.plus(j > 1 ? sums[above - 1] : semiring.zero(),
+                               j < i ? sums[above] : semiring.zero());
+    }
+    if (parent == semiring.zero() || pyramid->admissible[cell] == false) {
+        return semiring.zero();
+    }
+    return semiring.times(parent, pyramid->cells[cell]);
+}
+
+template <class Index, class S, class Admit>
+void IncrementalSolver<Index, S, Admit>::solveAll()
+{
+    // Time Complexity: O(V) where V are the cells
+    for (Index i = 1; i <= pyramid->levelCount; i++) {
+        reached[i] = 0;
+        for (Index j = 1; j <= i; j++) {
+            Value sum = this->relaxCell(i, j);
+            sums[i * (i - 1) / 2 + j - 1] = sum;
+            reached[i] += sum != semiring.zero() ? 1 : 0;
+        }
+    }
+}
+
+template <class Index, class S, class Admit>
+void IncrementalSolver<Index, S, Admit>::updateCell(Index row, Index col, Weight value)
+{
+    // Time Complexity: O(cone) where the cone is the triangle below the cell,
+    // it widens by one number per level and stops at the first level whose sums did not change
+    Index cell = row * (row - 1) / 2 + col - 1;
+    pyramid->cells[cell] = value;
+    admit.prepare(&value, (Index) 1);
+    pyramid->admissible[cell] = admit(value);
+
+    Index low = col, high = col; // numbers of level i to recompute
+    for (Index i = row; i <= pyramid->levelCount && low <= high; i++) {
+        Index changedLow = i + 1, changedHigh = 0;
+        for (Index j = low; j <= high; j++) {
+            Value &sum = sums[i * (i - 1) / 2 + j - 1];
+            Value updated = this->relaxCell(i, j);
+            if (updated != sum) {
+                reached[i] += (updated != semiring.zero() ? 1 : 0) - (sum != semiring.zero() ? 1 : 0);
+                sum = updated;
+                changedLow = j < changedLow ? j : changedLow;
+                changedHigh = j;
+            }
+        }
+        // the children of number j are numbers j and j+1 of the next level
+        low = changedLow;
+        high = changedHigh + 1 <= i + 1 ? changedHigh + 1 : i + 1;
+    }
+}
+
+template <class Index, class S, class Admit>
+typename S::Value IncrementalSolver<Index, S, Admit>::result() const
+{
+    // Same answer as RollingSum::result()
+    Index levelCount = pyramid->levelCount;
+    Index lastLevel = 0;
+    while (lastLevel < levelCount && reached[lastLevel + 1] > 0) {
+        lastLevel++;
+    }
+    const Value *level = sums + lastLevel * (lastLevel - 1) / 2;
+    return answerValue(semiring, lastLevel, lastLevel == levelCount, [level](Index j) { return level[j - 1]; });
+}
+
+template <class Index, class Weight>
+void buildDAG(const Pyramid<Index, Weight>& pyramid, DAG<Index, Weight> *& dag, Weight neutral) {
+    // neutral is the weight of the edges to the stop node, it leaves a path unchanged
+    Index N = pyramid.levelCount;
+    Index NSum = N * (N + 1) / 2;
+    // every number has at most two parents, the bottom-most ones an extra stop edge
+    DAGBuilder<Index, Weight> builder(NSum + 2, 2 * NSum + N + 1);
+
+    if (N == 0 || pyramid.admissible[0] == false) {
+        dag = builder.build();
+        return;
+    }
+    builder.addEdge(0, 1, pyramid.cells[0]);
+
+    Index index = 1;
+    // Create the out-edges of each node in vertex order if the destination node is not prime
+    for (Index i = 1; i <= N; i++) {
+        for (Index j = 0; j < i; j++, index++) {
+            if (i == N) {
+                if (pyramid.admissible[index - 1]) {
+                    builder.addEdge(index, NSum + 1, neutral);
+                }
+                continue;
+            }
+            Weight left = pyramid.cells[index + i - 1]; // level i+1, number j+1
+            Weight right = pyramid.cells[index + i]; // level i+1, number j+2
+            if (pyramid.admissible[index + i - 1]) {
+                builder.addEdge(index, index + i, left);
+            }
+            if (pyramid.admissible[index + i]) {
+                builder.addEdge(index, index + i + 1, right);
+            }
+        }
+    }
+    dag = builder.build();
+}
+
+} // namespace maxsum
+
+#endif // MAXSUM_PYRAMID_H
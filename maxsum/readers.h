@@ -0,0 +1,574 @@
+#ifndef MAXSUM_READERS_H
+#define MAXSUM_READERS_H
+
+#include <algorithm> // count, fill, reverse
+#include <cstdlib> // strtoll
+#include <cstring> // memchr
+#include <deque> // deque
+#include <fstream> // ifstream
+#include <istream> // istream
+#include <limits> // numeric_limits
+#include <ostream> // ostream
+#include <string> // string, getline, to_string
+#include <vector> // STL Vector
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap, madvise, munmap
+#include <sys/stat.h> // stat, fstat
+#include <unistd.h> // close
+#endif
+
+#include "pyramid.h"
+
+namespace maxsum {
+
+template <class Index>
+std::string tooManyLevels(long long levelCount) {
+    // why a pyramid can not be read, see levelsFit
+    return "Pyramid of " + std::to_string(levelCount) + " levels has too many numbers for "
+         + (sizeof(Index) < 8 ? "32-bit indices, it needs --index-bits=64." : "64-bit indices.");
+}
+
+template <class Index, class Weight, class Admit>
+bool readInput(Index N, std::istream& in, std::ostream *prompt, Pyramid<Index, Weight> *& pyramid, Admit& admit,
+               std::string& error) {
+    // Interactive: each number is asked for on prompt unless it is NULL
+    // Returns false with an empty pyramid and the reason in error if N levels do not fit Index.
+    if (levelsFit<Index>(N) == false) {
+        pyramid = new Pyramid<Index, Weight>(0);
+        error = tooManyLevels<Index>(N);
+        return false;
+    }
+    pyramid = new Pyramid<Index, Weight>(N);
+
+    if (N == 0) {
+        return true;
+    }
+    if (prompt != NULL) {
+        *prompt << "Level 1, Number 1: ";
+    }
+    in >> pyramid->cells[0];
+    admit.prepare(pyramid->cells, 1);
+    if(admit(pyramid->cells[0]) == false) {
+        return true; // nothing below is reachable
+    }
+
+    Index index = 1;
+    // Read the pyramid level by level
+    for (Index i = 2; i <= N; i++) {
+        for (Index j = 0; j < i; j++, index++) {
+            if (prompt != NULL) {
+                *prompt << "Level " << i << ", Number " << j+1 << ": ";
+            }
+            in >> pyramid->cells[index];
+        }
+    }
+    return true;
+}
+
+template <class Weight>
+const char *parseNumbers(const char *text, std::vector<Weight>& numbers) {
+    // Appends the numbers at the start of text, returns where parsing stopped
+    char *end = NULL;
+    while (true) {
+        long long num = strtoll(text, &end, 10);
+        if (end == text) {
+            break;
+        }
+        numbers.push_back((Weight) num);
+        text = end;
+    }
+    while (*text == ' ' || *text == '\t' || *text == '\r') {
+        text++;
+    }
+    return text;
+}
+
+template <class Index, class Weight>
+bool readInput(std::istream& in, Pyramid<Index, Weight> *& pyramid, std::string& error) {
+    // Single pass: the level count is the line count, found while the numbers
+    // are appended, so the input is read once and need not be seekable
+    // Returns false with the reason in error if the levels do not fit Index.
+    pyramid = new Pyramid<Index, Weight>(0);
+
+    long long N = 0;
+    bool parsing = true; // like >>, numbers after something else are zero
+    bool fits = true; // once the levels or numbers do not fit Index, lines are only counted
+    std::string line;
+    std::vector<Weight> numbers;
+    while (std::getline(in, line)) {
+        N++;
+        fits = fits && levelsFit<Index>(N);
+        if (parsing == true && fits == true) {
+            numbers.clear();
+            parsing = *parseNumbers(line.c_str(), numbers) == '\0';
+            fits = numbers.size() <= (size_t) std::numeric_limits<Index>::max() &&
+                   pyramid->append(numbers.data(), (Index) numbers.size());
+        }
+    }
+
+    if (fits == false || levelsFit<Index>(N) == false) {
+        pyramid->clear();
+        error = tooManyLevels<Index>(N);
+        return false;
+    }
+    pyramid->resize((Index) N);
+    return true;
+}
+
+template <class Index, class Weight>
+bool readText(const char *p, const char *end, Pyramid<Index, Weight> *pyramid, std::string& error) {
+    // Scans the digits straight from memory into an empty pyramid, same rules as
+    // readInput: the level count is the line count and numbers after something
+    // else are zero. The pyramid keeps its allocations, so it can be reused.
+    // Returns false with the pyramid left empty if the levels do not fit Index.
+    const char *text = p;
+    long long N = 0;
+    Weight numbers[4096]; // appended to the pyramid in batches
+    int count = 0;
+
+    bool fits = true; // once the levels or numbers do not fit Index, lines are only counted
+    while (p < end) {
+        char c = *p;
+        if (c == '\n') {
+            N++;
+            p++;
+            if (levelsFit<Index>(N + 1) == false) {
+                break; // the next level would not fit
+            }
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f') {
+            p++;
+            continue;
+        }
+
+        bool negative = false;
+        const char *start = p;
+        if (c == '-' || c == '+') {
+            negative = c == '-';
+            p++;
+        }
+        if (p == end || *p < '0' || *p > '9') {
+            p = start;
+            break; // not a number, the rest are zero
+        }
+        unsigned long long num = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            num = num * 10 + (unsigned long long) (*p - '0');
+            p++;
+        }
+        numbers[count++] = (Weight) (negative ? 0 - num : num);
+        if (count == 4096) {
+            fits = pyramid->append(numbers, count);
+            count = 0;
+            if (fits == false) {
+                break;
+            }
+        }
+    }
+    if (count > 0) {
+        fits = pyramid->append(numbers, count);
+    }
+
+    // only lines are left to count
+    while (p < end) {
+        const char *newline = (const char *) memchr(p, '\n', end - p);
+        if (newline == NULL) {
+            break;
+        }
+        N++;
+        p = newline + 1;
+    }
+    if (end > text && end[-1] != '\n') {
+        N++; // last line has no line break
+    }
+
+    if (fits == false || levelsFit<Index>(N) == false) {
+        pyramid->clear();
+        error = tooManyLevels<Index>(N);
+        return false;
+    }
+    pyramid->resize((Index) N);
+    return true;
+}
+
+template <class Index, class Weight>
+bool readMapped(const char *filename, Pyramid<Index, Weight> *& pyramid, std::string& error) {
+    // Parses the mapped file with readText, error is set if readText fails.
+    // Returns false if the file can not be mapped (Eg: a FIFO), so the caller
+    // can fall back to the stream reader.
+#if defined(__unix__) || defined(__APPLE__)
+    // checked before opening: a FIFO opened and closed here would lose what its writer sent
+    struct stat info;
+    if (stat(filename, &info) != 0 || S_ISREG(info.st_mode) == false) {
+        return false;
+    }
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &info) != 0 || S_ISREG(info.st_mode) == false) {
+        close(fd); // replaced since stat
+        return false;
+    }
+    size_t size = (size_t) info.st_size;
+    if (size == 0) {
+        close(fd);
+        pyramid = new Pyramid<Index, Weight>(0);
+        return true;
+    }
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    pyramid = new Pyramid<Index, Weight>(0);
+    readText((const char *) mapped, (const char *) mapped + size, pyramid, error);
+
+    munmap(mapped, size);
+    return true;
+#else
+    (void) filename;
+    (void) pyramid;
+    (void) error;
+    return false;
+#endif
+}
+
+template <class Index, class S, class Admit>
+void readInput(Index N, std::istream& in, std::ostream *prompt, RollingSum<Index, S>& rolling, Admit& admit) {
+    typedef typename S::Number Weight;
+    Weight *row = new Weight[N > 0 ? N : 1];
+    unsigned char *admissible = new unsigned char[N > 0 ? N : 1];
+
+    // Read the pyramid level by level, only the current level is kept
+    for (Index i = 1; i <= N; i++) {
+        std::fill(row, row + i, (Weight) 0); // numbers that can not be read are zero, as in the pyramid
+        for (Index j = 0; j < i; j++) {
+            if (prompt != NULL) {
+                *prompt << "Level " << i << ", Number " << j+1 << ": ";
+            }
+            in >> row[j];
+        }
+        classify(row, i, admissible, admit);
+        rolling.addLevel(row, admissible);
+        if (rolling.lastLevel == 0) {
+            break; // the top-most number is not admitted, nothing is reachable
+        }
+    }
+
+    delete [] row;
+    delete [] admissible;
+}
+
+struct LevelStart {
+    std::streampos where; // start of the line holding the first number of a level, -1 if its numbers are all zero
+    long long line; // 1-based number of that line
+    size_t skip; // numbers of that line before the level
+};
+
+template <class Weight>
+struct LevelScanner {
+    // Hands out the numbers of a text input level by level, parsed line by line with
+    // parseNumbers like the other readers: the level count is the line count, numbers
+    // after something else are zero and levels short of numbers at the end are completed
+    // with zeros. Only a level and the line it ends in are held, however long the input.
+    struct Line {
+        std::streampos where; // where the line starts
+        long long number; // 1-based
+        long long first; // count of numbers parsed before it
+    };
+
+    std::istream *in;
+    std::vector<Weight> numbers; // queued, those before next were handed out already
+    size_t next;
+    std::vector<Weight> padded; // the last queued numbers and zeros, for levels short of numbers
+    long long lines; // lines read
+    long long parsed; // numbers parsed
+    long long handed; // numbers handed out
+    bool parsing; // false once something else than numbers was read
+    bool more; // false at the end of the input
+    bool tracking; // whether the lines with numbers are kept for start(), the input must be seekable
+    std::deque<Line> queued; // lines with numbers still queued, oldest first
+
+    LevelScanner(std::istream& in, bool tracking = false);
+
+    const Weight *take(long long level); // the numbers of the next level, NULL if the input has fewer lines
+    LevelStart start(); // where the next level starts, for tracking scanners
+    bool resume(const LevelStart& from); // the next level is the one that started at from, false if seeking fails
+    void readLine(); // queues the numbers of the next line
+};
+
+template <class Weight>
+LevelScanner<Weight>::LevelScanner(std::istream& in, bool tracking) {
+    this->in = &in;
+    this->next = 0;
+    this->lines = 0;
+    this->parsed = 0;
+    this->handed = 0;
+    this->parsing = true;
+    this->more = true;
+    this->tracking = tracking;
+}
+
+template <class Weight>
+void LevelScanner<Weight>::readLine()
+{
+    std::streampos where = this->tracking == true ? this->in->tellg() : std::streampos(-1);
+    std::string line;
+    this->more = (bool) std::getline(*this->in, line);
+    if (this->more == false) {
+        return;
+    }
+    this->lines++;
+    if (this->parsing == true) {
+        size_t before = this->numbers.size();
+        this->parsing = *parseNumbers(line.c_str(), this->numbers) == '\0';
+        if (this->tracking == true && this->numbers.size() > before) {
+            Line queuedLine = {where, this->lines, this->parsed};
+            this->queued.push_back(queuedLine);
+        }
+        this->parsed += (long long) (this->numbers.size() - before);
+    }
+}
+
+template <class Weight>
+const Weight *LevelScanner<Weight>::take(long long level)
+{
+    // Time Complexity: O(level) amortized, level i is handed out once i lines were read
+    // and i numbers are queued, or at the end of the input
+    this->numbers.erase(this->numbers.begin(), this->numbers.begin() + this->next);
+    this->next = 0;
+    while (this->more == true && (this->lines < level || this->numbers.size() < (size_t) level)) {
+        this->readLine();
+    }
+    if (this->lines < level) {
+        return NULL;
+    }
+
+    const Weight *row = this->numbers.data();
+    if (this->numbers.size() < (size_t) level) {
+        this->padded.assign(this->numbers.begin(), this->numbers.end());
+        this->padded.resize((size_t) level, (Weight) 0);
+        row = this->padded.data();
+        this->next = this->numbers.size();
+    } else {
+        this->next = (size_t) level;
+    }
+    this->handed += (long long) this->next;
+    return row;
+}
+
+template <class Weight>
+LevelStart LevelScanner<Weight>::start()
+{
+    // the line of the first number not handed out yet, or the next line if none is queued
+    while (this->queued.size() >= 2 && this->queued[1].first <= this->handed) {
+        this->queued.pop_front();
+    }
+    LevelStart from = {std::streampos(-1), this->lines + 1, 0};
+    if (this->handed < this->parsed) {
+        from.where = this->queued.front().where;
+        from.line = this->queued.front().number;
+        from.skip = (size_t) (this->handed - this->queued.front().first);
+    } else if (this->parsing == true && this->more == true) {
+        from.where = this->in->tellg();
+    }
+    return from;
+}
+
+template <class Weight>
+bool LevelScanner<Weight>::resume(const LevelStart& from)
+{
+    this->numbers.clear();
+    this->queued.clear();
+    this->next = 0;
+    this->parsed = 0;
+    this->handed = 0;
+    this->in->clear();
+    if (from.where == std::streampos(-1)) {
+        // the rest are zero, and the levels resumed were handed out before so their lines exist
+        this->parsing = false;
+        this->more = false;
+        this->lines = std::numeric_limits<long long>::max();
+        return true;
+    }
+    if (!this->in->seekg(from.where)) {
+        return false;
+    }
+    this->lines = from.line - 1;
+    this->parsing = true;
+    this->more = true;
+    this->readLine();
+    this->next = from.skip < this->numbers.size() ? from.skip : this->numbers.size();
+    this->handed = (long long) this->next;
+    return true;
+}
+
+template <class Index, class S, class Admit>
+void readInput(std::istream& in, RollingSum<Index, S>& rolling, Admit& admit) {
+    // Single pass, same rules as the pyramid reader (see LevelScanner),
+    // so the input need not be seekable (pipes, stdin, FIFOs)
+    typedef typename S::Number Weight;
+    LevelScanner<Weight> scanner(in);
+    std::vector<unsigned char> admissible;
+    for (Index i = 1; ; i++) {
+        const Weight *row = scanner.take(i);
+        if (row == NULL) {
+            return;
+        }
+        admissible.resize((size_t) i);
+        classify(row, i, admissible.data(), admit);
+        rolling.addLevel(row, admissible.data());
+        if (rolling.lastLevel != i) {
+            return; // nothing below is reachable, the rest need not be read
+        }
+    }
+}
+
+template <class Index, class S, class Admit>
+bool readCheckpointed(std::ifstream& inFile, RollingSum<Index, S>& rolling, Admit& admit, std::vector<Index>& cells,
+                      std::string& error) {
+    typedef typename S::Number Weight;
+    typedef typename S::Value Value;
+    // Like readInput, but the sums above every K-th level and where that level starts
+    // in the file are kept, K = sqrt(N). The path is then recovered a segment at a time
+    // from the bottom: its levels are read again and solved with one bit per number,
+    // so O(N sqrt(N)) sums and bits are held instead of a bit for every number.
+    // The file is read three times: its lines are counted for N, then it is solved,
+    // then the segments are read once more (each level once in all).
+    // Returns false with the reason in error if the file can not be read again (Eg: a FIFO).
+    Index N = 0;
+    char buffer[1 << 16];
+    char last = '\n';
+    while (inFile.read(buffer, sizeof(buffer)) || inFile.gcount() > 0) {
+        std::streamsize count = inFile.gcount();
+        N += (Index) std::count(buffer, buffer + count, '\n');
+        last = buffer[count - 1];
+    }
+    if (last != '\n') {
+        N++; // the last line has no newline
+    }
+    if (levelsFit<Index>(N) == false) {
+        error = tooManyLevels<Index>(N); // cells of the path can not be numbered
+        return false;
+    }
+
+    inFile.clear();
+    inFile.seekg(0); // move cursor to start of file
+    if (!inFile || inFile.tellg() != std::streampos(0)) {
+        error = "Input is not seekable, checkpointed paths read it more than once.";
+        return false;
+    }
+
+    Index K = 1;
+    while (K * K < N) {
+        K++;
+    }
+    Index segments = N > 0 ? (N - 1) / K + 1 : 0;
+    Value **checkpoints = new Value*[segments > 0 ? segments : 1] (); // sums of level s-1, s = c*K+1
+    LevelStart *positions = new LevelStart[segments > 0 ? segments : 1];
+    unsigned char *admissible = new unsigned char[N > 0 ? N : 1];
+    LevelScanner<Weight> scanner(inFile, true);
+
+    for (Index i = 1; i <= N; i++) {
+        if ((i - 1) % K == 0) {
+            Index c = (i - 1) / K;
+            checkpoints[c] = new Value[i + 1];
+            std::copy(rolling.prev, rolling.prev + i + 1, checkpoints[c]);
+            positions[c] = scanner.start();
+        }
+        const Weight *row = scanner.take(i);
+        if (row == NULL) {
+            break; // the file changed since its lines were counted
+        }
+        classify(row, i, admissible, admit);
+        rolling.addLevel(row, admissible);
+        if (rolling.lastLevel != i) {
+            break; // nothing below is reachable, the rest need not be read
+        }
+    }
+
+    cells.clear();
+    Index j = rolling.resultNumber();
+    for (Index end = rolling.lastLevel; j != 0 && end >= 1; ) {
+        Index c = (end - 1) / K;
+        Index start = c * K + 1;
+        RollingSum<Index, S> segment(end, rolling.pool, rolling.semiring, rolling.kernel);
+        segment.resume(start - 1, checkpoints[c]);
+        segment.recordPath();
+
+        if (scanner.resume(positions[c]) == false) {
+            error = "Input is not seekable, checkpointed paths read it more than once.";
+            break;
+        }
+        for (Index i = start; i <= end; i++) {
+            const Weight *row = scanner.take(i);
+            if (row == NULL) {
+                error = "Input changed while its path was recovered.";
+                break;
+            }
+            classify(row, i, admissible, admit);
+            segment.addLevel(row, admissible);
+        }
+        if (error.compare("") != 0) {
+            break;
+        }
+        j = segment.trace(j, cells);
+        end = start - 1;
+    }
+    std::reverse(cells.begin(), cells.end());
+
+    for (Index c = 0; c < segments; c++) {
+        delete [] checkpoints[c];
+    }
+    delete [] checkpoints;
+    delete [] positions;
+    delete [] admissible;
+    return error.compare("") == 0;
+}
+
+template <class Index, class S, class Admit>
+bool readStream(std::istream& in, RollingSum<Index, S>& rolling, Admit& admit, std::string& error) {
+    typedef typename S::Number Weight;
+    // Each line is one level and is solved as soon as it arrives,
+    // so no level count and no seeking are needed (pipes, stdin, FIFOs).
+    // Returns false with the reason in error if a line is not a level.
+    std::string line;
+    std::vector<Weight> row;
+    std::vector<unsigned char> admissible;
+
+    while (std::getline(in, line)) {
+        row.clear();
+        if (*parseNumbers(line.c_str(), row) != '\0') {
+            error = "Level " + std::to_string(rolling.levelCount + 1) + " is not a list of numbers.";
+            return false;
+        }
+        if (row.empty()) {
+            continue; // blank line
+        }
+        if ((Index) row.size() != rolling.levelCount + 1) {
+            error = "Level " + std::to_string(rolling.levelCount + 1) + " should have "
+                  + std::to_string(rolling.levelCount + 1) + " numbers.";
+            return false;
+        }
+
+        admissible.resize(row.size());
+        classify(row.data(), (Index) row.size(), admissible.data(), admit);
+        rolling.addLevel(row.data(), admissible.data());
+        if (rolling.lastLevel != rolling.levelCount) {
+            break; // nothing below is reachable, the answer is known
+        }
+    }
+
+    // drain the rest so that the producer is not cut off with a broken pipe
+    while (in.ignore(1 << 20)) {}
+    return true;
+}
+
+} // namespace maxsum
+
+#endif // MAXSUM_READERS_H
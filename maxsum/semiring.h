@@ -0,0 +1,136 @@
+#ifndef MAXSUM_SEMIRING_H
+#define MAXSUM_SEMIRING_H
+
+#include <limits> // numeric_limits
+#include <ostream> // ostream
+#include <type_traits> // make_unsigned
+
+namespace maxsum {
+
+/*
+ * Semirings decide what the solvers compute over the same pyramid.
+ * plus() chooses between the two parents, times() extends a path by a number,
+ * zero() marks a number no path reaches and one() is the start (source) node.
+ */
+
+template <class Weight>
+struct MaxPlus {
+    typedef Weight Number;
+    typedef Weight Value;
+
+    Value zero() const { return std::numeric_limits<Value>::min(); }
+    Value one() const { return 0; }
+    Value plus(Value a, Value b) const { return a > b ? a : b; }
+    Value times(Value a, Number w) const { return wrappingAdd(a, w); }
+    Number neutral() const { return 0; } // weight of the edges to the stop node
+    const char *label() const { return "Maximum Sum"; }
+
+    static Value wrappingAdd(Value a, Number w) {
+        // overflow wraps around like the vector kernels instead of being undefined
+        typedef typename std::make_unsigned<Value>::type Unsigned;
+        return (Value) ((Unsigned) a + (Unsigned) w);
+    }
+};
+
+template <class Weight>
+struct MinPlus {
+    typedef Weight Number;
+    typedef Weight Value;
+
+    Value zero() const { return std::numeric_limits<Value>::max(); }
+    Value one() const { return 0; }
+    Value plus(Value a, Value b) const { return a < b ? a : b; }
+    Value times(Value a, Number w) const { return MaxPlus<Weight>::wrappingAdd(a, w); }
+    Number neutral() const { return 0; }
+    const char *label() const { return "Minimum Sum"; }
+};
+
+template <class Weight>
+struct PathCount {
+    typedef Weight Number;
+    typedef unsigned long long Value; // modulo 2^64
+
+    Value zero() const { return 0; }
+    Value one() const { return 1; }
+    Value plus(Value a, Value b) const { return a + b; }
+    Value times(Value a, Number) const { return a; }
+    Number neutral() const { return 0; }
+    const char *label() const { return "Path Count"; }
+};
+
+template <class Weight>
+struct Bottleneck {
+    typedef Weight Number;
+    typedef Weight Value;
+
+    Value zero() const { return std::numeric_limits<Value>::min(); }
+    Value one() const { return std::numeric_limits<Value>::max(); }
+    Value plus(Value a, Value b) const { return a > b ? a : b; }
+    Value times(Value a, Number w) const { return a < w ? a : w; }
+    Number neutral() const { return std::numeric_limits<Number>::max(); }
+    const char *label() const { return "Bottleneck"; }
+};
+
+template <class Count>
+void writeCount(std::ostream& out, Count count) {
+    // also prints 128-bit counts, which ostream does not know
+    char digits[40];
+    int length = 0;
+    do {
+        digits[length++] = (char) ('0' + (int) (count % 10));
+        count /= 10;
+    } while (count != 0);
+    while (length > 0) {
+        out << digits[--length];
+    }
+}
+
+template <class Weight, class Count>
+struct CountedMaxPlus {
+    typedef Weight Number;
+    struct Value {
+        Weight sum; // maximum sum
+        Count best; // paths with the maximum sum
+        Count all; // all admissible paths
+
+        bool operator==(const Value& other) const {
+            return sum == other.sum && best == other.best && all == other.all;
+        }
+        bool operator!=(const Value& other) const { return !(*this == other); }
+        friend std::ostream& operator<<(std::ostream& out, const Value& value) {
+            out << value.sum << " (";
+            writeCount(out, value.best);
+            out << " of ";
+            writeCount(out, value.all);
+            return out << " paths)";
+        }
+    };
+
+    Count modulus; // counts are kept modulo it, 0 to let them wrap at the width of Count
+
+    CountedMaxPlus(Count modulus = 0) { this->modulus = modulus; }
+
+    Value zero() const { Value value = { std::numeric_limits<Weight>::min(), 0, 0 }; return value; }
+    Value one() const { Value value = { 0, 1, 1 }; return value; }
+    Value plus(Value a, Value b) const {
+        Value value;
+        value.sum = a.sum > b.sum ? a.sum : b.sum;
+        value.best = add(a.sum == value.sum ? a.best : 0, b.sum == value.sum ? b.best : 0);
+        value.all = add(a.all, b.all);
+        return value;
+    }
+    Value times(Value a, Number w) const { a.sum = MaxPlus<Weight>::wrappingAdd(a.sum, w); return a; }
+    Number neutral() const { return 0; }
+    const char *label() const { return "Maximum Sum"; }
+
+    Count add(Count a, Count b) const {
+        if (modulus == 0) {
+            return a + b;
+        }
+        return a >= modulus - b ? a - (modulus - b) : a + b; // a, b < modulus, no overflow
+    }
+};
+
+} // namespace maxsum
+
+#endif // MAXSUM_SEMIRING_H
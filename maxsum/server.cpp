@@ -0,0 +1,588 @@
+#include <algorithm> // sort
+#include <cerrno> // errno
+#include <chrono> // steady_clock
+#include <cmath> // ceil
+#include <condition_variable> // condition_variable
+#include <cstdlib> // atoll
+#include <cstring> // memchr, memcpy, memmove, memset, strerror
+#include <deque> // deque
+#include <fstream> // ifstream
+#include <functional> // cref, ref
+#include <mutex> // mutex, lock_guard, unique_lock
+#include <sstream> // ostringstream
+#include <string> // string, to_string
+#include <thread> // thread
+#include <vector> // STL Vector
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h> // fcntl, O_NONBLOCK
+#include <poll.h> // poll
+#include <sys/socket.h> // socket, bind, listen, accept, connect, recv, send
+#include <sys/stat.h> // stat
+#include <sys/un.h> // sockaddr_un
+#include <unistd.h> // close, pipe, read, unlink, write
+#endif
+
+#include "server.h"
+#include "primes.h"
+#include "readers.h"
+
+namespace maxsum {
+
+LoadStats::LoadStats() {
+    this->requests = 0;
+    this->errors = 0;
+    this->seconds = 0;
+    this->p50 = 0;
+    this->p90 = 0;
+    this->p99 = 0;
+    this->p999 = 0;
+    this->max = 0;
+    this->response = "";
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+int openSocket(const std::string& socketPath, bool listening, std::string& error) {
+    // Listens on socketPath, replacing a stale socket, or connects to it
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        error = "Socket path " + socketPath + " is too long.";
+        return -1;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::string("Can not create socket: ") + strerror(errno) + ".";
+        return -1;
+    }
+    if (listening == true) {
+        struct stat info;
+        if (stat(socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+            unlink(socketPath.c_str());
+        }
+        if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(fd, 128) != 0) {
+            error = "Can not listen on " + socketPath + ": " + strerror(errno) + ".";
+            close(fd);
+            return -1;
+        }
+    } else if (connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        error = "Can not connect to " + socketPath + ": " + strerror(errno) + ".";
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+namespace {
+
+const long long maxRequest = 1LL << 30; // bytes of one pyramid
+
+bool sendAll(int fd, const std::string& data) {
+    // a full socket buffer of a non-blocking session is waited for
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL; // a peer that hung up is an error, not a signal
+#else
+    int flags = 0;
+#endif
+    for (size_t done = 0; done < data.size(); ) {
+        ssize_t sent = send(fd, data.data() + done, data.size() - done, flags);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd writable = {fd, POLLOUT, 0};
+            poll(&writable, 1, -1);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        done += (size_t) sent;
+    }
+    return true;
+}
+
+struct Connection {
+    int fd;
+    char buffer[65536]; // received bytes not consumed yet are [start, end)
+    size_t start;
+    size_t end;
+
+    Connection(int fd);
+
+    bool readLine(std::string& line); // without the line break, false if the peer hung up
+};
+
+Connection::Connection(int fd) {
+    this->fd = fd;
+    this->start = 0;
+    this->end = 0;
+}
+
+bool Connection::readLine(std::string& line)
+{
+    line.clear();
+    while (true) {
+        const char *newline = (const char *) memchr(this->buffer + this->start, '\n', this->end - this->start);
+        if (newline != NULL) {
+            line.append((const char *) this->buffer + this->start, newline);
+            this->start = newline + 1 - this->buffer;
+            return true;
+        }
+        line.append(this->buffer + this->start, this->end - this->start);
+        if (line.size() > 1024) {
+            return false; // not a header
+        }
+
+        ssize_t received = recv(this->fd, this->buffer, sizeof(this->buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            received = 0;
+        } else if (received <= 0) {
+            return false;
+        }
+        this->start = 0;
+        this->end = (size_t) received;
+    }
+}
+
+struct Session {
+    int fd;
+    std::vector<char> buffer; // received bytes are [0, filled), the request being assembled starts at 0
+    size_t filled;
+    std::string header; // once it arrived, "" before
+    size_t start; // of the pyramid, after the header line
+    size_t length; // of header and pyramid, 0 before the header arrived
+    bool closing; // the peer hung up or its answer could not be sent
+
+    Session(int fd);
+
+    bool receive(); // false if the peer hung up
+    int assemble(); // 1 once the whole request is buffered, 0 while it is not, -1 if the connection ends
+    void consume(); // drops the answered request, keeping what arrived after it
+};
+
+Session::Session(int fd) {
+    this->fd = fd;
+    this->filled = 0;
+    this->header = "";
+    this->start = 0;
+    this->length = 0;
+    this->closing = false;
+}
+
+bool Session::receive()
+{
+    // the buffer grows to hold the whole request once its length is known
+    size_t wanted = this->length > this->filled ? this->length : this->filled + 65536;
+    if (this->buffer.size() < wanted) {
+        this->buffer.resize(wanted);
+    }
+    ssize_t received = recv(this->fd, this->buffer.data() + this->filled, this->buffer.size() - this->filled, 0);
+    if (received < 0) {
+        return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    this->filled += (size_t) received;
+    return received > 0;
+}
+
+int Session::assemble()
+{
+    if (this->length == 0) {
+        const char *data = this->buffer.data();
+        const char *newline = (const char *) memchr(data, '\n', this->filled);
+        if (newline == NULL) {
+            return this->filled > 1024 ? -1 : 0; // not a header
+        }
+        this->header.assign(data, newline);
+        long long size = -1; // bytes of the pyramid
+        if (this->header.compare(0, 5, "TEXT ") == 0) {
+            size = atoll(this->header.c_str() + 5);
+        } else if (this->header.compare(0, 7, "BINARY ") == 0) {
+            long long levels = atoll(this->header.c_str() + 7);
+            size = levels >= 0 && levels < (1LL << 20) ? levels * (levels + 1) / 2 * 8 : -1;
+        }
+        if (size < 0 || size > maxRequest) {
+            // the pyramid can not be skipped without its length
+            sendAll(this->fd, "ERROR Unknown or too large request " + this->header.substr(0, 64) + ".\n");
+            return -1;
+        }
+        this->start = (size_t) (newline + 1 - data);
+        this->length = this->start + (size_t) size;
+    }
+    return this->filled >= this->length ? 1 : 0;
+}
+
+void Session::consume()
+{
+    memmove(this->buffer.data(), this->buffer.data() + this->length, this->filled - this->length);
+    this->filled -= this->length;
+    this->header = "";
+    this->start = 0;
+    this->length = 0;
+}
+
+struct Dispatcher {
+    std::mutex lock; // guards the queues and stopping
+    std::condition_variable ready; // a request was queued
+    std::deque<Session *> requests; // whole requests for the workers
+    std::vector<Session *> answered; // handed back to the poll loop
+    bool stopping;
+    int wake[2]; // pipe, a byte on it tells the poll loop that sessions were answered
+
+    Dispatcher();
+
+    void queue(Session *session);
+};
+
+Dispatcher::Dispatcher() {
+    this->stopping = false;
+    this->wake[0] = -1;
+    this->wake[1] = -1;
+}
+
+void Dispatcher::queue(Session *session)
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->requests.push_back(session);
+    }
+    this->ready.notify_one();
+}
+
+std::string respond(const Result& result) {
+    if (result.status != 0) {
+        return "ERROR " + result.error + "\n";
+    }
+    std::ostringstream out;
+    out << "OK " << result.answers.size() << "\n";
+    for (size_t k = 0; k < result.answers.size(); k++) {
+        out << result.answers[k].value << '\t' << formatPath(result.answers[k].path) << '\n';
+    }
+    return out.str();
+}
+
+void answerRequests(Dispatcher *dispatcher, Solver *solver) {
+    // Worker: one request at a time of whichever session, the binary buffer is kept for the next ones
+    std::vector<long long> numbers;
+    while (true) {
+        Session *session = NULL;
+        {
+            std::unique_lock<std::mutex> guard(dispatcher->lock);
+            dispatcher->ready.wait(guard, [dispatcher] {
+                return dispatcher->requests.empty() == false || dispatcher->stopping == true;
+            });
+            if (dispatcher->stopping == true) {
+                break;
+            }
+            session = dispatcher->requests.front();
+            dispatcher->requests.pop_front();
+        }
+
+        const char *pyramid = session->buffer.data() + session->start;
+        size_t size = session->length - session->start;
+        std::string response;
+        if (session->header.compare(0, 5, "TEXT ") == 0) {
+            response = respond(solver->solve(pyramid, size));
+        } else {
+            numbers.resize(size / 8); // aligned
+            memcpy(numbers.data(), pyramid, size);
+            response = respond(solver->solve(numbers.data(), atoll(session->header.c_str() + 7)));
+        }
+        session->closing = sendAll(session->fd, response) == false;
+        session->consume();
+
+        {
+            std::lock_guard<std::mutex> guard(dispatcher->lock);
+            dispatcher->answered.push_back(session);
+        }
+        char byte = 0;
+        if (write(dispatcher->wake[1], &byte, 1) < 0) {
+            // the pipe is full, the poll loop is woken already
+        }
+    }
+}
+
+void loadConnection(const std::string& socketPath, const std::string& request, long long count,
+                    std::vector<double>& latencies, long long& errors, std::string *response) {
+    // Closed loop: the next request is sent once the answer of the last one arrived
+    typedef std::chrono::steady_clock Clock;
+    std::string error;
+    int fd = openSocket(socketPath, false, error);
+    if (fd < 0) {
+        errors += count;
+        return;
+    }
+    Connection *connection = new Connection(fd);
+    std::string line;
+
+    for (long long i = 0; i < count; i++) {
+        Clock::time_point start = Clock::now();
+        if (sendAll(fd, request) == false || connection->readLine(line) == false) {
+            errors += count - i;
+            break;
+        }
+        if (line.compare(0, 3, "OK ") != 0) {
+            errors++;
+            if (response != NULL && i == 0) {
+                *response = line;
+            }
+            continue;
+        }
+        long long answers = atoll(line.c_str() + 3);
+        bool complete = true;
+        for (long long k = 0; k < answers && complete == true; k++) {
+            complete = connection->readLine(line);
+            if (response != NULL && i == 0) {
+                *response += (k > 0 ? "\n" : "") + line;
+            }
+        }
+        if (complete == false) {
+            errors += count - i;
+            break;
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+
+    close(fd);
+    delete connection;
+}
+
+} // namespace
+
+void serveConnections(int listener, const std::vector<Solver *>& solvers, int *failure) {
+    // Poll loop: accepts connections and receives their requests, which the first idle worker answers.
+    // A session is handed to one worker at a time, so its answers keep the order of its requests.
+    Dispatcher dispatcher;
+    if (pipe(dispatcher.wake) != 0) {
+        *failure = errno;
+        return;
+    }
+    fcntl(dispatcher.wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(dispatcher.wake[1], F_SETFL, O_NONBLOCK);
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < solvers.size(); w++) {
+        workers.push_back(std::thread(answerRequests, &dispatcher, solvers[w]));
+    }
+
+    std::vector<Session *> idle; // waiting for (the rest of) a request
+    std::vector<Session *> next;
+    std::vector<Session *> answered;
+    std::vector<struct pollfd> polled;
+    while (true) {
+        polled.clear();
+        struct pollfd listening = {listener, POLLIN, 0};
+        struct pollfd woken = {dispatcher.wake[0], POLLIN, 0};
+        polled.push_back(listening);
+        polled.push_back(woken);
+        for (size_t i = 0; i < idle.size(); i++) {
+            struct pollfd readable = {idle[i]->fd, POLLIN, 0};
+            polled.push_back(readable);
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            *failure = errno;
+            break;
+        }
+
+        // sessions with new bytes, then those answered, which may have the next request buffered already
+        next.clear();
+        for (size_t i = 0; i < idle.size(); i++) {
+            int state = 0;
+            if (polled[i + 2].revents != 0) {
+                state = idle[i]->receive() == true ? idle[i]->assemble() : -1;
+            }
+            if (state > 0) {
+                dispatcher.queue(idle[i]);
+            } else if (state < 0) {
+                close(idle[i]->fd);
+                delete idle[i];
+            } else {
+                next.push_back(idle[i]);
+            }
+        }
+        idle.swap(next);
+        if (polled[1].revents != 0) {
+            char bytes[256];
+            while (read(dispatcher.wake[0], bytes, sizeof(bytes)) > 0) {
+            }
+            {
+                std::lock_guard<std::mutex> guard(dispatcher.lock);
+                answered.swap(dispatcher.answered);
+            }
+            for (size_t i = 0; i < answered.size(); i++) {
+                int state = answered[i]->closing == true ? -1 : answered[i]->assemble();
+                if (state > 0) {
+                    dispatcher.queue(answered[i]);
+                } else if (state < 0) {
+                    close(answered[i]->fd);
+                    delete answered[i];
+                } else {
+                    idle.push_back(answered[i]);
+                }
+            }
+            answered.clear();
+        }
+
+        if (polled[0].revents != 0) {
+            int fd = accept(listener, NULL, NULL); // blocking, it fails once the listener is shut down
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                idle.push_back(new Session(fd));
+            } else if (errno != EINTR && errno != ECONNABORTED) {
+                *failure = errno;
+                break;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(dispatcher.lock);
+        dispatcher.stopping = true;
+    }
+    dispatcher.ready.notify_all();
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+    // the sessions still queued or answered end with the idle ones
+    idle.insert(idle.end(), dispatcher.requests.begin(), dispatcher.requests.end());
+    idle.insert(idle.end(), dispatcher.answered.begin(), dispatcher.answered.end());
+    for (size_t i = 0; i < idle.size(); i++) {
+        close(idle[i]->fd);
+        delete idle[i];
+    }
+    close(dispatcher.wake[0]);
+    close(dispatcher.wake[1]);
+}
+
+#endif
+
+std::string serve(const Options& options, const std::string& socketPath, int workers)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (workers <= 0) {
+        workers = (int) std::thread::hardware_concurrency();
+    }
+    if (workers <= 0) {
+        workers = 1;
+    }
+
+    PrimeSieve sieve(options.sieveLimit); // shared by the solvers
+    std::vector<Solver *> solvers;
+    for (int w = 0; w < workers; w++) {
+        solvers.push_back(new Solver(options, &sieve));
+    }
+    std::string error = solvers[0]->error;
+    if (error.compare("") == 0 && options.lanes == true) {
+        error = "Vector lanes solve batches of pyramids, not the single one of each request.";
+    }
+    if (error.compare("") == 0) {
+        int listener = openSocket(socketPath, true, error);
+        if (listener >= 0) {
+            int failure = 0;
+            serveConnections(listener, solvers, &failure); // returns only if accept fails
+            error = std::string("Can not accept connections: ") + strerror(failure) + ".";
+            close(listener);
+        }
+    }
+
+    for (int w = 0; w < workers; w++) {
+        delete solvers[w];
+    }
+    return error;
+#else
+    (void) options;
+    (void) socketPath;
+    (void) workers;
+    return "Unix domain sockets are not supported on this platform.";
+#endif
+}
+
+std::string loadTest(const std::string& socketPath, const std::string& filename, bool binary,
+                     long long requests, int connections, LoadStats& stats)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    typedef std::chrono::steady_clock Clock;
+    std::ifstream inFile;
+    inFile.open(filename);
+    if (!inFile) {
+        return "Can not open input file.";
+    }
+    std::string request;
+    if (binary == true) {
+        Pyramid<long long, long long> * pyramid = NULL;
+        std::string error;
+        if (readInput(inFile, pyramid, error) == false) {
+            delete pyramid;
+            return error;
+        }
+        request = "BINARY " + std::to_string(pyramid->levelCount) + "\n";
+        request.append((const char *) pyramid->cells, (size_t) pyramid->cellCount * sizeof(long long));
+        delete pyramid;
+    } else {
+        std::ostringstream contents;
+        contents << inFile.rdbuf();
+        request = "TEXT " + std::to_string(contents.str().size()) + "\n" + contents.str();
+    }
+    inFile.close();
+
+    std::string error;
+    int probe = openSocket(socketPath, false, error);
+    if (probe < 0) {
+        return error;
+    }
+    close(probe);
+
+    if (connections <= 0) {
+        connections = 1;
+    }
+    if (requests < connections) {
+        connections = requests > 0 ? (int) requests : 1;
+    }
+    std::vector<std::vector<double> > latencies(connections);
+    std::vector<long long> errors(connections, 0);
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+    for (int c = 0; c < connections; c++) {
+        long long count = requests / connections + (c < requests % connections ? 1 : 0);
+        threads.push_back(std::thread(loadConnection, std::cref(socketPath), std::cref(request), count,
+                                      std::ref(latencies[c]), std::ref(errors[c]), c == 0 ? &stats.response : NULL));
+    }
+    for (int c = 0; c < connections; c++) {
+        threads[c].join();
+    }
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> all;
+    for (int c = 0; c < connections; c++) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        stats.errors += errors[c];
+    }
+    stats.requests = (long long) all.size();
+    if (all.empty() == false) {
+        std::sort(all.begin(), all.end());
+        double *percentiles[] = {&stats.p50, &stats.p90, &stats.p99, &stats.p999};
+        double ranks[] = {0.5, 0.9, 0.99, 0.999};
+        for (int k = 0; k < 4; k++) {
+            size_t rank = (size_t) std::ceil(ranks[k] * all.size()); // nearest rank
+            *percentiles[k] = all[rank > 0 ? rank - 1 : 0];
+        }
+        stats.max = all.back();
+    }
+    return "";
+#else
+    (void) socketPath;
+    (void) filename;
+    (void) binary;
+    (void) requests;
+    (void) connections;
+    (void) stats;
+    return "Unix domain sockets are not supported on this platform.";
+#endif
+}
+
+} // namespace maxsum
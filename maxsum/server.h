@@ -0,0 +1,53 @@
+#ifndef MAXSUM_SERVER_H
+#define MAXSUM_SERVER_H
+
+#include <string> // string
+#include <vector> // STL Vector
+
+#include "maxsum.h"
+
+/*
+ * Solver daemon on a local Unix domain socket, and a load generator for it.
+ * One thread polls the listener and all connections and buffers their requests,
+ * each whole request goes to the first idle worker thread. Each worker keeps a
+ * Solver, so primes (sieved once for all of them), level threads and buffers
+ * stay warm between requests, and an idle connection holds none of them.
+ * Only a client that does not read its answers keeps a worker waiting.
+ *
+ * A request is a header line followed by the pyramid:
+ *   "TEXT <bytes>\n" and that many bytes in the format of the input files, or
+ *   "BINARY <levels>\n" and levels*(levels+1)/2 64-bit numbers in host byte order.
+ * A connection may send any number of requests, each is answered in order with
+ *   "OK <answers>\n" and one "<value>\t<level>,<number> <level>,<number> ...\n" line per answer
+ * (the path is empty unless the server was started with a path mode), or with
+ *   "ERROR <message>\n".
+ */
+
+namespace maxsum {
+
+std::string serve(const Options& options, const std::string& socketPath, int workers); // returns why it stopped
+
+// What serve() is made of: a socket listening on (or connected to) socketPath, -1 with the reason in error,
+// and the poll loop answering the connections accepted on listener with one worker thread per solver
+// until accept fails, with its errno in failure
+int openSocket(const std::string& socketPath, bool listening, std::string& error);
+void serveConnections(int listener, const std::vector<Solver *>& solvers, int *failure);
+
+struct LoadStats {
+    long long requests; // answered with OK
+    long long errors; // answered with ERROR or not at all
+    double seconds; // wall time of the whole run
+    double p50, p90, p99, p999, max; // latency percentiles in microseconds
+    std::string response; // answer lines of the first request
+
+    LoadStats();
+};
+
+// Sends the pyramid of filename requests times over connections parallel connections,
+// each waiting for its answer before the next request, returns why it failed or ""
+std::string loadTest(const std::string& socketPath, const std::string& filename, bool binary,
+                     long long requests, int connections, LoadStats& stats);
+
+} // namespace maxsum
+
+#endif // MAXSUM_SERVER_H
@@ -0,0 +1,1037 @@
+/**
+ * @file tests/check.cpp
+ *
+ * @brief Checks of the solvers, run by "make check"
+ *
+ * Random pyramids are solved by every engine, reader, kernel and path mode, and with
+ * vector lanes, and each answer is compared with that of the DAG engine.
+ * The DAG answers, the best sums of "--top" and the counts of "max-count" are compared
+ * with those found by enumerating every path, and primality with trial division.
+ * Each feature then has its own check, called from main():
+ * levels split between threads, incremental updates, batches on several workers,
+ * the topological sort of unordered DAGs, blank trailing levels, the level limits
+ * of 32-bit indices, the socket protocol of the server and a sieve shared by threads.
+ * The comment of each check names the backlog requests (user-NNN) whose feature it covers.
+ * Prints the failures and exits with 1 if there are any.
+ */
+
+#include <algorithm> // sort, min, max
+#include <atomic> // atomic
+#include <cerrno> // errno
+#include <chrono> // milliseconds
+#include <climits> // INT_MAX, LLONG_MAX
+#include <csignal> // signal, SIGPIPE
+#include <cstdio> // perror, remove
+#include <cstdlib> // atoll
+#include <cstring> // strerror
+#include <fstream> // ifstream, ofstream
+#include <functional> // cref, ref
+#include <iostream> // cout
+#include <iterator> // istreambuf_iterator
+#include <sstream> // istringstream, ostringstream
+#include <string> // string, to_string
+#include <thread> // thread
+#include <vector> // STL Vector
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h> // open
+#include <sys/socket.h> // recv, send, shutdown
+#include <sys/stat.h> // mkdir, mkfifo, chmod
+#include <unistd.h> // access, close, getpid, rmdir, unlink, write
+#endif
+
+#include "../maxsum/batch.h"
+#include "../maxsum/maxsum.h"
+#include "../maxsum/primes.h"
+#include "../maxsum/pyramid.h"
+#include "../maxsum/server.h"
+
+using namespace std;
+
+typedef vector<vector<long long> > Rows;
+
+const char *checkFile = "check.tmp"; // pyramid for the engines that read a file
+
+long long checks = 0;
+long long failures = 0;
+
+void expect(bool ok, const string& what, const string& pyramid) {
+    checks++;
+    if (ok == true) {
+        return;
+    }
+    failures++;
+    if (failures <= 20) {
+        cout << "FAIL: " << what << endl << pyramid << "--" << endl;
+    }
+}
+
+unsigned long long state = 88172645463325252ULL; // xorshift, the same pyramids on every run
+
+long long randomNumber(long long low, long long high) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return low + (long long) (state % (unsigned long long) (high - low + 1));
+}
+
+Rows makeRows(int levels, bool large) {
+    // mostly small numbers so that primes, composites and ties are common
+    Rows rows(levels);
+    for (int i = 0; i < levels; i++) {
+        for (int j = 0; j <= i; j++) {
+            long long num = randomNumber(-20, 60);
+            if (large == true && randomNumber(0, 3) == 0) {
+                num = randomNumber(0, 1) == 0 ? randomNumber(1500000000, INT_MAX) : randomNumber(-INT_MAX, -1500000000);
+            }
+            rows[i].push_back(num);
+        }
+    }
+    return rows;
+}
+
+string toText(const Rows& rows) {
+    ostringstream out;
+    for (size_t i = 0; i < rows.size(); i++) {
+        for (size_t j = 0; j < rows[i].size(); j++) {
+            out << (j > 0 ? " " : "") << rows[i][j];
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+string malformedText(int levels) {
+    // lines with numbers missing or to spare, and words after which the numbers are zero
+    ostringstream out;
+    for (int i = 1; i <= levels; i++) {
+        int count = i + (int) randomNumber(-2, 2);
+        for (int j = 0; j < count; j++) {
+            out << (j > 0 ? " " : "") << randomNumber(-5, 40);
+        }
+        if (randomNumber(0, 19) == 0) {
+            out << " x 4";
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+maxsum::Result solveText(maxsum::Options options, const string& text, bool file) {
+    if (file == true) {
+        ofstream outFile(checkFile);
+        outFile << text;
+        outFile.close();
+        options.filename = checkFile;
+    } else {
+        options.filename = "-";
+    }
+    istringstream input(text);
+    return maxsum::solve(options, input);
+}
+
+bool trialPrime(long long num) {
+    if (num < 2) {
+        return false;
+    }
+    for (long long d = 2; d * d <= num; d++) {
+        if (num % d == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool admitted(const string& admit, long long num) {
+    if (admit.compare("composite") == 0) {
+        return num > 3 && trialPrime(num) == false;
+    }
+    if (admit.compare(0, 10, "divisible:") == 0) {
+        return num % atoll(admit.c_str() + 10) == 0;
+    }
+    if (admit.compare(0, 6, "range:") == 0) {
+        size_t colon = admit.find(':', 6);
+        return num >= atoll(admit.c_str() + 6) && num <= atoll(admit.c_str() + colon + 1);
+    }
+    return trialPrime(num) == false;
+}
+
+struct Brute {
+    // The paths the answer is taken from, found by enumerating every admitted path:
+    // those that reach the bottom-most level, or else those that end at the last
+    // reachable number of the deepest level reached
+    int last; // deepest level reached, 0 if the top-most number is not admitted
+    vector<vector<int> > paths; // 0-based number of each level
+
+    Brute(const Rows& rows, const string& admit);
+    void extend(const Rows& rows, const string& admit, vector<int>& path, vector<vector<int> >& all);
+};
+
+Brute::Brute(const Rows& rows, const string& admit) {
+    vector<vector<int> > all;
+    vector<int> path;
+    this->last = 0;
+    if (rows.empty() == false && admitted(admit, rows[0][0]) == true) {
+        path.push_back(0);
+        this->extend(rows, admit, path, all);
+    }
+    for (size_t p = 0; p < all.size(); p++) {
+        this->last = max(this->last, (int) all[p].size());
+    }
+    int end = -1; // number the paths end at if the bottom is not reached
+    for (size_t p = 0; p < all.size(); p++) {
+        if ((int) all[p].size() == this->last) {
+            end = max(end, all[p].back());
+        }
+    }
+    for (size_t p = 0; p < all.size(); p++) {
+        if ((int) all[p].size() == this->last && (this->last == (int) rows.size() || all[p].back() == end)) {
+            this->paths.push_back(all[p]);
+        }
+    }
+}
+
+void Brute::extend(const Rows& rows, const string& admit, vector<int>& path, vector<vector<int> >& all) {
+    all.push_back(path);
+    size_t i = path.size();
+    if (i == rows.size()) {
+        return;
+    }
+    for (int j = path.back(); j <= path.back() + 1; j++) {
+        if (admitted(admit, rows[i][j]) == true) {
+            path.push_back(j);
+            this->extend(rows, admit, path, all);
+            path.pop_back();
+        }
+    }
+}
+
+long long pathValue(const string& semiring, bool wide, const Rows& rows, const vector<int>& path) {
+    // sum, or smallest number for bottleneck, sums wrap around at 32 bits like the solvers
+    long long value = semiring.compare("bottleneck") == 0 ? LLONG_MAX : 0;
+    for (size_t i = 0; i < path.size(); i++) {
+        long long num = rows[i][path[i]];
+        if (semiring.compare("bottleneck") == 0) {
+            value = min(value, num);
+        } else {
+            value = wide == true ? value + num : (long long) (int) (unsigned int) (value + num);
+        }
+    }
+    if (semiring.compare("bottleneck") == 0 && path.empty() == true) {
+        return wide == true ? LLONG_MAX : INT_MAX; // the start node
+    }
+    return value;
+}
+
+bool better(const string& semiring, long long a, long long b) {
+    return semiring.compare("min-plus") == 0 ? a < b : a > b;
+}
+
+vector<long long> bestValues(const string& semiring, bool wide, const Rows& rows, const Brute& brute) {
+    // values of the paths of brute, best first, or that of the start node if there are none
+    vector<long long> values;
+    for (size_t p = 0; p < brute.paths.size(); p++) {
+        values.push_back(pathValue(semiring, wide, rows, brute.paths[p]));
+    }
+    if (values.empty() == true) {
+        values.push_back(pathValue(semiring, wide, rows, vector<int>()));
+    }
+    sort(values.begin(), values.end(), [&semiring](long long a, long long b) { return better(semiring, a, b); });
+    return values;
+}
+
+string bruteAnswer(const string& semiring, unsigned long long modulus, bool wide, const Rows& rows,
+                   const Brute& brute) {
+    if (semiring.compare("count") == 0) {
+        return to_string(brute.paths.empty() == true ? 1 : brute.paths.size());
+    }
+    vector<long long> values = bestValues(semiring, wide, rows, brute);
+    if (semiring.compare("max-count") != 0) {
+        return to_string(values[0]);
+    }
+    unsigned long long best = 0;
+    for (size_t p = 0; p < values.size(); p++) {
+        best += values[p] == values[0] ? 1 : 0;
+    }
+    unsigned long long all = values.size();
+    if (modulus != 0) {
+        best %= modulus;
+        all %= modulus;
+    }
+    return to_string(values[0]) + " (" + to_string(best) + " of " + to_string(all) + " paths)";
+}
+
+bool validPath(const string& semiring, bool wide, const string& admit, const Rows& rows, const Brute& brute,
+               const maxsum::Answer& answer) {
+    // a path the answer is taken from, with the value of the answer
+    if ((int) answer.path.size() != brute.last) {
+        return false;
+    }
+    vector<int> path;
+    for (size_t i = 0; i < answer.path.size(); i++) {
+        long long number = answer.path[i].number - 1;
+        if (answer.path[i].level != (long long) i + 1 || number < 0 || number > (long long) i ||
+            (i > 0 && number != path.back() && number != path.back() + 1) ||
+            admitted(admit, rows[i][number]) == false) {
+            return false;
+        }
+        path.push_back((int) number);
+    }
+    bool ends = path.empty() == true;
+    for (size_t p = 0; p < brute.paths.size(); p++) {
+        ends = ends || brute.paths[p].back() == path.back();
+    }
+    return ends == true && to_string(pathValue(semiring, wide, rows, path)) == answer.value;
+}
+
+struct Variant {
+    const char *engine;
+    const char *reader;
+    const char *kernel;
+    const char *path;
+    int threads;
+    bool file;
+};
+
+const Variant variants[] = {
+    {"implicit", "mmap", "auto", "", 1, true},
+    {"implicit", "mmap", "scalar", "", 1, true},
+    {"implicit", "stream", "auto", "", 1, true},
+    {"implicit", "stream", "auto", "", 3, false},
+    {"implicit", "mmap", "scalar", "bits", 1, true},
+    {"implicit", "mmap", "auto", "bits", 1, false},
+    {"rolling", "mmap", "auto", "", 1, true},
+    {"rolling", "mmap", "scalar", "", 1, false},
+    {"rolling", "mmap", "auto", "bits", 1, false},
+    {"rolling", "mmap", "scalar", "checkpoint", 1, true},
+    {"stream", "mmap", "auto", "", 1, false},
+    {"stream", "mmap", "scalar", "bits", 1, false},
+    {"dag", "mmap", "auto", "bits", 1, true},
+};
+
+struct SemiringCase {
+    const char *name;
+    unsigned long long modulus;
+};
+
+const SemiringCase semirings[] = {
+    {"max-plus", 0}, {"min-plus", 0}, {"count", 0}, {"bottleneck", 0}, {"max-count", 0}, {"max-count", 7},
+};
+
+const char *admits[] = {"not-prime", "composite", "divisible:3", "range:0:40"};
+
+string describe(const maxsum::Options& options) {
+    return "--engine=" + options.engine + " --reader=" + options.reader + " --kernel=" + options.kernel +
+           " --semiring=" + options.semiring + " --modulus=" + to_string(options.modulus) +
+           " --admit=" + options.admit + " --weight-bits=" + to_string(options.weightBits) +
+           " --path=" + options.path + " --threads=" + to_string(options.threads) +
+           " --top=" + to_string(options.top);
+}
+
+void checkEngines(const string& text, const Rows *rows, bool wellFormed, bool large) {
+    // every variant against the DAG engine, and the DAG engine against the paths if rows are given
+    // (not for sums of large numbers that wrap around at 32 bits, the engines may then disagree)
+    // Engines user-001 to user-006 and user-009 to user-017, semirings user-014 and user-019, predicates user-015
+    for (size_t s = 0; s < sizeof(semirings) / sizeof(semirings[0]); s++) {
+        for (size_t a = 0; a < sizeof(admits) / sizeof(admits[0]); a++) {
+            for (int wide = 0; wide <= 1; wide++) {
+                maxsum::Options options;
+                options.semiring = semirings[s].name;
+                options.modulus = semirings[s].modulus;
+                options.admit = admits[a];
+                options.indexBits = wide == 1 ? 64 : 32;
+                options.weightBits = wide == 1 ? 64 : 32;
+                options.sieveLimit = randomNumber(0, 1) == 0 ? 100 : 100000; // Miller-Rabin above it
+                bool summing = options.semiring.compare("count") != 0 && options.semiring.compare("bottleneck") != 0;
+                if (large == true && wide == 0 && summing == true) {
+                    continue;
+                }
+                options.engine = "dag";
+                maxsum::Result reference = solveText(options, text, false);
+                expect(reference.status == 0 && reference.answers.size() == 1, describe(options), text);
+                if (reference.status != 0 || reference.answers.size() != 1) {
+                    continue;
+                }
+
+                Brute *brute = rows != NULL ? new Brute(*rows, options.admit) : NULL;
+                if (brute != NULL) {
+                    string answer = bruteAnswer(options.semiring, options.modulus, wide == 1, *rows, *brute);
+                    expect(reference.answers[0].value == answer,
+                           describe(options) + " gives " + reference.answers[0].value + ", not " + answer, text);
+                }
+
+                bool counting = options.semiring.compare("count") == 0 || options.semiring.compare("max-count") == 0;
+                for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+                    const Variant& variant = variants[v];
+                    if ((counting == true && variant.path[0] != '\0') ||
+                        (wellFormed == false && string(variant.engine).compare("stream") == 0)) {
+                        continue; // no paths to recover, or no lines to reject
+                    }
+                    options.engine = variant.engine;
+                    options.reader = variant.reader;
+                    options.kernel = variant.kernel;
+                    options.path = variant.path;
+                    options.threads = variant.threads;
+                    maxsum::Result result = solveText(options, text, variant.file);
+                    bool same = result.status == 0 && result.answers.size() == 1 &&
+                                result.answers[0].value == reference.answers[0].value;
+                    expect(same, describe(options) + " gives " + (result.status == 0 && result.answers.empty() == false
+                           ? result.answers[0].value : result.error) + ", not " + reference.answers[0].value, text);
+                    if (same == true && brute != NULL && options.path.compare("") != 0) {
+                        expect(validPath(options.semiring, wide == 1, options.admit, *rows, *brute, result.answers[0]),
+                               describe(options) + " path " + maxsum::formatPath(result.answers[0].path), text);
+                    }
+                }
+                delete brute;
+            }
+        }
+    }
+}
+
+void checkTop(const string& text, const Rows& rows) {
+    // the K best sums against those of every path, each with a path that has it (user-018)
+    const char *choosing[] = {"max-plus", "min-plus", "bottleneck"};
+    for (int s = 0; s < 3; s++) {
+        for (size_t a = 0; a < sizeof(admits) / sizeof(admits[0]); a++) {
+            for (long long K = 1; K <= 40; K *= 3) {
+                maxsum::Options options;
+                options.semiring = choosing[s];
+                options.admit = admits[a];
+                options.top = K;
+                maxsum::Result result = solveText(options, text, false);
+                Brute brute(rows, options.admit);
+                vector<long long> values = bestValues(options.semiring, false, rows, brute);
+                size_t shown = min((size_t) K, values.size());
+                bool same = result.status == 0 && result.answers.size() == shown;
+                for (size_t k = 0; k < shown && same == true; k++) {
+                    same = result.answers[k].value == to_string(values[k]) &&
+                           validPath(options.semiring, false, options.admit, rows, brute, result.answers[k]);
+                }
+                expect(same, describe(options), text);
+            }
+        }
+    }
+}
+
+void checkLanes() {
+    // runs of pyramids of the same height solved side by side, one Solver for all of them (user-025)
+    for (size_t s = 0; s < sizeof(semirings) / sizeof(semirings[0]); s++) {
+        for (int wide = 0; wide <= 1; wide++) {
+            for (int lanes = 0; lanes <= 1; lanes++) {
+                maxsum::Options options;
+                options.semiring = semirings[s].name;
+                options.modulus = semirings[s].modulus;
+                options.admit = randomNumber(0, 1) == 0 ? "not-prime" : "range:-10:50";
+                options.indexBits = wide == 1 ? 64 : 32;
+                options.weightBits = wide == 1 ? 64 : 32;
+                options.kernel = randomNumber(0, 1) == 0 ? "auto" : "scalar";
+                options.lanes = lanes == 1;
+
+                vector<string> texts;
+                const int heights[] = {0, 1, 2, 3, 5, 8, 13, 40};
+                while (texts.size() < 100) {
+                    int levels = heights[randomNumber(0, 7)];
+                    for (long long run = randomNumber(1, 12); run > 0; run--) {
+                        texts.push_back(toText(makeRows(levels, wide == 1 && randomNumber(0, 3) == 0)));
+                    }
+                }
+                vector<const char *> starts;
+                vector<size_t> lengths;
+                for (size_t k = 0; k < texts.size(); k++) {
+                    starts.push_back(texts[k].c_str());
+                    lengths.push_back(texts[k].size());
+                }
+                vector<maxsum::Result> results(texts.size());
+                maxsum::Solver solver(options);
+                solver.solve(starts.data(), lengths.data(), texts.size(), results.data());
+
+                options.engine = "dag";
+                options.lanes = false;
+                for (size_t k = 0; k < texts.size(); k++) {
+                    maxsum::Result reference = solveText(options, texts[k], false);
+                    expect(results[k].status == 0 && results[k].answers.size() == 1 &&
+                           reference.answers.size() == 1 && results[k].answers[0].value == reference.answers[0].value,
+                           describe(options) + (lanes == 1 ? " --lanes" : " solver"), texts[k]);
+                }
+            }
+        }
+    }
+
+    // lanes that would be ignored are an error instead
+    maxsum::Options options;
+    options.lanes = true;
+    maxsum::Result single = solveText(options, "1\n2 3\n", false);
+    expect(single.status != 0 && single.error.find("Vector lanes") == 0, "--lanes without a batch", single.error);
+    options.path = "bits";
+    expect(maxsum::validate(options).find("Vector lanes") == 0, "--lanes --path", maxsum::validate(options));
+    options.path = "";
+    options.top = 2;
+    expect(maxsum::validate(options).find("Vector lanes") == 0, "--lanes --top=2", maxsum::validate(options));
+}
+
+template <class S>
+void checkLevelPool(const S& semiring, const char *kernelName) {
+    // wide levels split between threads against the scalar kernel alone, with chunks small
+    // enough that pyramids of a few hundred levels take the parallel path on most levels (user-010)
+    maxsum::LevelKernel<int, S> kernel, scalar;
+    kernel.select(kernelName);
+    for (int threads = 2; threads <= 5; threads += 3) {
+        maxsum::LevelPool<int, S> pool(threads, kernel);
+        pool.minChunk = 16;
+        for (int p = 0; p < 12; p++) {
+            Rows rows = makeRows((int) randomNumber(100, 400), false);
+            maxsum::Pyramid<int, typename S::Number> pyramid(0);
+            for (size_t i = 0; i < rows.size(); i++) {
+                vector<typename S::Number> row(rows[i].begin(), rows[i].end());
+                pyramid.append(row.data(), (int) row.size());
+            }
+            pyramid.resize((int) rows.size());
+            maxsum::ValueRange admit(-15, 60); // deep pyramids whose paths still end early now and then
+            pyramid.classify(admit);
+
+            vector<int> path, poolPath;
+            typename S::Value expected = pyramid.maximumSum(semiring, (maxsum::LevelPool<int, S> *) NULL, &path,
+                                                            scalar);
+            typename S::Value value = pyramid.maximumSum(semiring, &pool, &poolPath, kernel);
+            expect(value == expected && poolPath == path, string("--path --threads=") + to_string(threads) +
+                   " --kernel=" + kernelName + " on " + to_string(rows.size()) + " levels", "");
+        }
+    }
+}
+
+template <class S, class Admit>
+void checkUpdates(const S& semiring, Admit admit, const string& admitName) {
+    // each incremental update against a full solve of the updated pyramid (user-020)
+    for (int p = 0; p < 20; p++) {
+        Rows rows = makeRows((int) randomNumber(1, 40), false);
+        maxsum::Pyramid<int, int> pyramid(0);
+        for (size_t i = 0; i < rows.size(); i++) {
+            vector<int> row(rows[i].begin(), rows[i].end());
+            pyramid.append(row.data(), (int) row.size());
+        }
+        pyramid.resize((int) rows.size());
+        pyramid.classify(admit);
+
+        maxsum::IncrementalSolver<int, S, Admit> solver(&pyramid, semiring, admit);
+        for (int u = 0; u < 60; u++) {
+            int row = (int) randomNumber(1, pyramid.levelCount);
+            int col = (int) randomNumber(1, row);
+            int value = (int) randomNumber(-20, 60);
+            solver.updateCell(row, col, value);
+            expect(solver.result() == pyramid.maximumSum(semiring), string(semiring.label()) + " --admit=" + admitName +
+                   " after setting level " + to_string(row) + ", number " + to_string(col) + " to " + to_string(value),
+                   toText(rows));
+        }
+    }
+
+    // --bench-updates prints the answer of the input, not that of the updated pyramid
+    Rows rows = makeRows(30, false);
+    maxsum::Options options;
+    options.admit = admitName;
+    maxsum::Result reference = solveText(options, toText(rows), true);
+    options.updates = 200;
+    maxsum::Result result = solveText(options, toText(rows), true);
+    expect(result.status == 0 && result.answers.size() == 1 && result.answers[0].value == reference.answers[0].value,
+           "--bench-updates=200 --admit=" + admitName, toText(rows));
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+string exchange(int fd, const string& request) {
+    // Sends request and returns the whole answer: the header line and as many lines as it announces
+    for (size_t done = 0; done < request.size(); ) {
+        ssize_t sent = send(fd, request.data() + done, request.size() - done, 0);
+        if (sent <= 0) {
+            return "";
+        }
+        done += (size_t) sent;
+    }
+    string response;
+    long long lines = -1; // left to read, once the header is known
+    char c = 0;
+    while (lines != 0 && recv(fd, &c, 1, 0) == 1) {
+        response += c;
+        if (c != '\n') {
+            continue;
+        }
+        if (lines > 0) {
+            lines--;
+        } else {
+            lines = response.compare(0, 3, "OK ") == 0 ? atoll(response.c_str() + 3) : 0;
+        }
+    }
+    return response;
+}
+
+void checkServerClient(const string& socketPath, int client, vector<string>& failed) {
+    // TEXT and BINARY requests on one connection, against maxsum::solve (user-022)
+    string error;
+    int fd = maxsum::openSocket(socketPath, false, error);
+    if (fd < 0) {
+        failed.push_back(error);
+        return;
+    }
+    for (int r = 0; r < 30; r++) {
+        int levels = r % 7 == 0 ? 0 : (int) (r * 7 + client) % 45;
+        Rows rows(levels);
+        string request = "BINARY " + to_string(levels) + "\n";
+        for (int i = 0; i < levels; i++) {
+            for (int j = 0; j <= i; j++) {
+                long long num = (r * 131 + i * 17 + j * 29 + client * 7) % 61 - 10;
+                rows[i].push_back(num);
+                request.append((const char *) &num, sizeof(num));
+            }
+        }
+        string text = toText(rows);
+        if (r % 2 == 0) {
+            request = "TEXT " + to_string(text.size()) + "\n" + text;
+        }
+        maxsum::Options options;
+        istringstream input(text);
+        options.filename = "-";
+        maxsum::Result expected = maxsum::solve(options, input);
+        string answer = exchange(fd, request);
+        if (answer != "OK 1\n" + expected.answers[0].value + "\t\n") {
+            failed.push_back("client " + to_string(client) + " request " + to_string(r) + " answered " + answer);
+        }
+    }
+
+    // a pyramid that is too large is an error, the connection goes on
+    string blank(46341, '\n');
+    string answer = exchange(fd, "TEXT " + to_string(blank.size()) + "\n" + blank);
+    if (answer.compare(0, 34, "ERROR Pyramid of 46341 levels has ") != 0) {
+        failed.push_back("client " + to_string(client) + " 46341 levels answered " + answer);
+    }
+    answer = exchange(fd, "TEXT 6\n1\n4 6\n");
+    if (answer != "OK 1\n7\t\n") {
+        failed.push_back("client " + to_string(client) + " after an error answered " + answer);
+    }
+
+    // a header that is not understood ends the connection
+    answer = exchange(fd, "HELLO\n");
+    char c = 0;
+    if (answer != "ERROR Unknown or too large request HELLO.\n" || recv(fd, &c, 1, 0) != 0) {
+        failed.push_back("client " + to_string(client) + " HELLO answered " + answer);
+    }
+    close(fd);
+}
+
+void checkServer() {
+    // two workers serving four clients at once on a temporary socket, next to connections that stay idle (user-022)
+    string socketPath = "check-" + to_string(getpid()) + ".sock";
+    string error;
+    int listener = maxsum::openSocket(socketPath, true, error);
+    expect(listener >= 0, "listen on " + socketPath + ": " + error, "");
+    if (listener < 0) {
+        return;
+    }
+    maxsum::Options options;
+    maxsum::Solver first(options), second(options);
+    vector<maxsum::Solver *> solvers = {&first, &second};
+    int failure = 0;
+    thread server(maxsum::serveConnections, listener, cref(solvers), &failure);
+
+    // a silent connection and one that sent half a request must not hold a worker
+    int silent = maxsum::openSocket(socketPath, false, error);
+    int partial = maxsum::openSocket(socketPath, false, error);
+    string half = "TEXT 6\n1\n4";
+    expect(silent >= 0 && partial >= 0 && send(partial, half.data(), half.size(), 0) == (ssize_t) half.size(),
+           "idle connections to " + socketPath, "");
+    this_thread::sleep_for(chrono::milliseconds(50)); // accepted before the clients
+
+    vector<string> failed[4];
+    vector<thread> clients;
+    for (int c = 0; c < 4; c++) {
+        clients.push_back(thread(checkServerClient, socketPath, c, ref(failed[c])));
+    }
+    for (int c = 0; c < 4; c++) {
+        clients[c].join();
+        for (size_t f = 0; f < failed[c].size(); f++) {
+            expect(false, "server: " + failed[c][f], "");
+        }
+        checks += 33 - (long long) failed[c].size();
+    }
+    string answer = exchange(partial, " 6\n");
+    expect(answer == "OK 1\n7\t\n", "the rest of a request sent after the other clients", answer);
+    close(silent);
+    close(partial);
+
+    shutdown(listener, SHUT_RDWR); // accept fails, the poll loop returns
+    server.join();
+    close(listener);
+    unlink(socketPath.c_str());
+}
+#endif
+
+string batchLine(const string& name, const maxsum::Result& result, bool paths) {
+    // the line of a pyramid as the batch writes it
+    string line = name;
+    if (result.status != 0) {
+        return line + "\tERROR " + result.error + "\n";
+    }
+    for (size_t k = 0; k < result.answers.size(); k++) {
+        line += "\t" + result.answers[k].value + (paths == true ? "\t" + maxsum::formatPath(result.answers[k].path) : "");
+    }
+    return line + "\n";
+}
+
+string runBatch(const maxsum::Options& options, int workers, const string& input, long long count) {
+    // the output of the batch, whose counts must add up to count pyramids
+    istringstream in(input);
+    ostringstream out;
+    maxsum::BatchStats stats;
+    string error = maxsum::solveBatch(options, workers, in, out, stats);
+    long long solved = 0, stolen = 0;
+    for (size_t w = 0; w < stats.workers.size(); w++) {
+        solved += stats.workers[w].pyramids;
+        stolen += stats.workers[w].stolen;
+    }
+    expect(error == "" && stats.pyramids == count && solved == count && stolen <= count &&
+           stats.workers.size() == (size_t) workers, describe(options) + " --batch --workers=" + to_string(workers) +
+           " counts " + to_string(stats.pyramids) + " pyramids, " + to_string(solved) + " solved, " +
+           to_string(stolen) + " stolen", "");
+    return out.str();
+}
+
+void checkBatch() {
+    // pyramids of mixed heights on several workers, which steal from each other,
+    // against one worker and against one Solver solving them in order (user-023, user-024)
+    vector<string> texts;
+    const int heights[] = {1, 2, 3, 8, 40, 300};
+    while (texts.size() < 400) {
+        int levels = heights[randomNumber(0, 5)];
+        for (long long run = randomNumber(1, 20); run > 0; run--) {
+            texts.push_back(toText(makeRows(levels, false)));
+        }
+    }
+    string input;
+    for (size_t k = 0; k < texts.size(); k++) {
+        input += texts[k] + "\n"; // a blank line ends each pyramid
+    }
+    for (int mode = 0; mode < 3; mode++) {
+        maxsum::Options options;
+        options.lanes = mode == 1;
+        options.path = mode == 2 ? "bits" : "";
+        options.admit = "range:-10:50";
+        maxsum::Solver solver(options);
+        string expected;
+        for (size_t k = 0; k < texts.size(); k++) {
+            expected += batchLine(to_string(k + 1), solver.solve(texts[k].c_str(), texts[k].size()), mode == 2);
+        }
+        string one = runBatch(options, 1, input, (long long) texts.size());
+        string four = runBatch(options, 4, input, (long long) texts.size());
+        expect(one == expected, describe(options) + " --batch --workers=1", "");
+        expect(four == expected, describe(options) + " --batch --workers=4", "");
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    // a directory: files in name order, hidden files and subdirectories skipped, and error lines
+    string directory = "check-" + to_string(getpid()) + ".dir";
+    if (mkdir(directory.c_str(), 0700) != 0) {
+        expect(false, "mkdir " + directory + ": " + strerror(errno), "");
+        return;
+    }
+    mkdir((directory + "/sub").c_str(), 0700);
+    vector<string> names;
+    for (size_t k = 0; k < 60; k++) {
+        string name = string(1, (char) ('a' + k % 26)) + to_string(k); // not in order of k
+        string text = k == 7 ? toText(makeRows(3, false)) + string(46341 - 3, '\n') : texts[k];
+        ofstream outFile((directory + "/" + name).c_str());
+        outFile << text;
+        names.push_back(name);
+    }
+    ofstream((directory + "/.hidden").c_str()) << "1\n";
+    string locked = directory + "/" + names[11];
+    chmod(locked.c_str(), 0); // still readable by root
+    bool unreadable = access(locked.c_str(), R_OK) != 0;
+
+    sort(names.begin(), names.end());
+    maxsum::Options options;
+    options.filename = directory;
+    maxsum::Solver solver(options);
+    string expected;
+    for (size_t k = 0; k < names.size(); k++) {
+        ifstream inFile((directory + "/" + names[k]).c_str());
+        string text((istreambuf_iterator<char>(inFile)), istreambuf_iterator<char>());
+        maxsum::Result result = solver.solve(text.c_str(), text.size());
+        if (directory + "/" + names[k] == locked && unreadable == true) {
+            result = maxsum::Result();
+            result.status = 1;
+            result.error = "Can not open input file.";
+        }
+        expected += batchLine(names[k], result, false);
+    }
+    expect(expected.find("ERROR") != string::npos, "directory batch has an error line", "");
+    expect(runBatch(options, 1, "", (long long) names.size()) == expected, "directory --batch --workers=1", "");
+    expect(runBatch(options, 4, "", (long long) names.size()) == expected, "directory --batch --workers=4", "");
+
+    for (size_t k = 0; k < names.size(); k++) {
+        unlink((directory + "/" + names[k]).c_str());
+    }
+    unlink((directory + "/.hidden").c_str());
+    rmdir((directory + "/sub").c_str());
+    rmdir(directory.c_str());
+#endif
+}
+
+void checkTopologicalSort() {
+    // a chain of a million vertices numbered against its direction, 0 -> V-2 -> V-3 -> ... -> 1 -> V-1,
+    // with shortcuts s -> s-2, which the sort must order without recursing a million deep (user-011),
+    // built from CSR edges that must come in source order (user-002)
+    const int V = 1000000;
+    vector<long long> weights(V, 0), shortcuts(V, 0);
+    maxsum::DAGBuilder<int, long long> builder(V, 2 * V);
+    int edges = builder.addEdge(0, V - 2, 0) + builder.addEdge(1, V - 1, 0);
+    for (int v = 2; v < V - 1; v++) {
+        weights[v] = randomNumber(-50, 50);
+        shortcuts[v] = randomNumber(-50, 50);
+        edges += builder.addEdge(v, v - 1, weights[v]);
+        if (v >= 3) {
+            edges += builder.addEdge(v, v - 2, shortcuts[v]);
+        }
+    }
+    bool rejected = builder.addEdge(V - 3, V - 1, 0) == false && builder.addEdge(V - 2, V, 0) == false;
+    maxsum::DAG<int, long long> *dag = builder.build();
+    expect(rejected == true && edges == 2 * V - 5 && dag->edgeAmount == edges,
+           "edges out of source order or range are rejected", to_string(dag->edgeAmount) + " edges");
+    expect(dag->topologicallyOrdered == false, "reversed chain is not ordered by vertex number", "");
+
+    vector<long long> best(V, LLONG_MIN); // sums by hand, from V-2 down to 1
+    best[V - 2] = 0;
+    for (int v = V - 2; v >= 2; v--) {
+        best[v - 1] = max(best[v - 1], best[v] + weights[v]);
+        if (v >= 3) {
+            best[v - 2] = max(best[v - 2], best[v] + shortcuts[v]);
+        }
+    }
+    long long sum = dag->maximumSum(maxsum::MaxPlus<long long>());
+    expect(sum == best[1], "maximum sum of the reversed chain", to_string(sum) + " instead of " + to_string(best[1]));
+    sum = dag->maximumSum(maxsum::MaxPlus<long long>()); // sorts again with the arrays of the first sort
+    expect(sum == best[1], "second maximum sum of the reversed chain", to_string(sum) + " instead of " + to_string(best[1]));
+
+    vector<int> position(V, -1);
+    for (int k = 0; k < V; k++) {
+        position[dag->order[k]] = k;
+    }
+    long long backwards = 0;
+    for (int v = 0; v < V; v++) {
+        for (int e = dag->offsets[v]; e < dag->offsets[v + 1]; e++) {
+            backwards += position[v] < 0 || position[v] >= position[dag->targets[e]] ? 1 : 0;
+        }
+    }
+    expect(backwards == 0, "topological order of the reversed chain", to_string(backwards) + " edges backwards");
+    delete dag;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+void checkFifo() {
+    // a FIFO given as filename, which the mmap reader must leave to the stream reader unopened (user-006)
+    string fifo = "check-" + to_string(getpid()) + ".fifo";
+    if (mkfifo(fifo.c_str(), 0600) != 0) {
+        expect(false, "mkfifo " + fifo + ": " + strerror(errno), "");
+        return;
+    }
+    signal(SIGPIPE, SIG_IGN); // a write to a FIFO nobody reads fails instead
+    string text = toText(makeRows(30, false));
+    maxsum::Options options;
+    options.admit = "range:-10:50";
+    options.engine = "dag";
+    maxsum::Result reference = solveText(options, text, false);
+    const char *engines[] = {"implicit", "implicit", "dag", "rolling", "stream"};
+    for (int e = 0; e < 5; e++) {
+        options.engine = engines[e];
+        options.reader = e == 1 ? "stream" : "mmap";
+        options.filename = fifo;
+        atomic<bool> done(false);
+        bool stuck = false;
+        thread writer([&fifo, &text, &done, &stuck]() {
+            int fd = open(fifo.c_str(), O_WRONLY); // blocks until the solver opens the FIFO
+            if (write(fd, text.data(), text.size()) < 0) {
+                perror("write");
+            }
+            close(fd);
+            // a reader that closed the FIFO and opened it again waits for another writer
+            for (int wait = 0; wait < 200 && done == false; wait++) {
+                this_thread::sleep_for(chrono::milliseconds(10));
+            }
+            if (done == false) {
+                stuck = true;
+                close(open(fifo.c_str(), O_WRONLY | O_NONBLOCK)); // lets it finish
+            }
+        });
+        istringstream input("");
+        maxsum::Result result = maxsum::solve(options, input);
+        done = true;
+        writer.join();
+        expect(stuck == false && result.status == 0 && result.answers[0].value == reference.answers[0].value,
+               describe(options) + " on a FIFO gives " + (result.status == 0 ? result.answers[0].value : result.error) +
+               (stuck == true ? " after waiting for a second writer" : ""),
+               text);
+    }
+    unlink(fifo.c_str());
+}
+#endif
+
+void checkBlankTail() {
+    // a few levels and then blank lines, whose numbers the readers complete with zeros (user-005)
+    Rows rows = makeRows(13, false);
+    string text = toText(rows) + string(2000 - 13, '\n');
+    maxsum::Options options;
+    options.admit = "range:-20:60";
+    options.engine = "dag";
+    maxsum::Result reference = solveText(options, text, false);
+    const char *engines[] = {"implicit", "rolling"};
+    for (int e = 0; e < 2; e++) {
+        for (int file = 0; file <= 1; file++) {
+            options.engine = engines[e];
+            options.path = "bits";
+            maxsum::Result result = solveText(options, text, file == 1);
+            expect(result.status == 0 && reference.status == 0 && result.answers[0].value == reference.answers[0].value &&
+                   result.answers[0].path.size() == 2000, describe(options) + " with a blank tail", toText(rows));
+        }
+    }
+}
+
+void checkLevelLimits() {
+    // 32-bit indices take N*(N+1) <= INT_MAX, so 46340 levels and no more,
+    // and the (N+1)^2 edges of the DAG one level less (user-013)
+    expect(maxsum::levelsFit<int>(46340) == true && maxsum::levelsFit<int>(46341) == false, "levelsFit<int>", "");
+    expect(maxsum::edgesFit<int>(46339) == true && maxsum::edgesFit<int>(46340) == false, "edgesFit<int>", "");
+    expect(maxsum::levelsFit<long long>(3037000499LL) == true && maxsum::levelsFit<long long>(3037000500LL) == false,
+           "levelsFit<long long>", "");
+
+    // a small pyramid followed by blank lines up to 46341 levels is rejected, not solved with wrapped offsets
+    string text = toText(makeRows(3, false)) + string(46341 - 3, '\n');
+    const char *engines[] = {"implicit", "dag"};
+    for (int e = 0; e < 2; e++) {
+        for (int r = 0; r < 3; r++) {
+            maxsum::Options options;
+            options.engine = engines[e];
+            options.reader = r == 1 ? "stream" : "mmap";
+            maxsum::Result result = solveText(options, text, r < 2);
+            expect(result.status != 0 && result.error.find("46341 levels") != string::npos,
+                   describe(options) + " on 46341 levels gives " + (result.status == 0 ? result.answers[0].value
+                                                                                     : result.error), "");
+        }
+    }
+    maxsum::Solver solver((maxsum::Options()));
+    maxsum::Result result = solver.solve(text.c_str(), text.size());
+    expect(result.status != 0 && result.error.find("46341 levels") != string::npos, "Solver on 46341 levels", "");
+
+    // numbers on every line: the readers stop storing them once the levels do not fit,
+    // but still count every line for the error
+    string numbered;
+    for (int i = 0; i < 60000; i++) {
+        numbered += "1 2 3 4 5\n";
+    }
+    for (int r = 0; r < 3; r++) {
+        maxsum::Options options;
+        options.reader = r == 1 ? "stream" : "mmap";
+        maxsum::Result result = solveText(options, numbered, r < 2);
+        expect(result.status != 0 && result.error.find("60000 levels") != string::npos,
+               describe(options) + " on 60000 levels gives " + (result.status == 0 ? result.answers[0].value
+                                                                                 : result.error), "");
+    }
+
+    // the cells of a pyramid can not grow beyond Index
+    maxsum::Pyramid<short, int> small(0);
+    vector<int> numbers(20000, 1);
+    expect(small.append(numbers.data(), 20000) == true && small.append(numbers.data(), 12767) == true &&
+           small.append(numbers.data(), 1) == false && small.cellCount == 32767 && small.capacity == 32767,
+           "Pyramid<short>::append beyond 32767 numbers", "");
+}
+
+void checkPrimes() {
+    // sieved bits and Miller-Rabin against trial division (user-007, user-008)
+    maxsum::PrimeSieve sieve(300000);
+    maxsum::PrimeSieve small(1000); // larger numbers are left to Miller-Rabin
+    for (int limit = 7; limit < 300000; limit = limit * 3 + (int) randomNumber(0, 100)) {
+        sieve.extend(limit); // in segments, as prepare() does
+    }
+    sieve.extend(300000);
+    small.extend(1000);
+    for (long long num = -20; num < 300000; num++) {
+        bool prime = trialPrime(num);
+        if (maxsum::isPrime(num) != prime || sieve.isPrime(num) != prime || small.isPrime(num) != prime) {
+            expect(false, "primality of " + to_string(num), "");
+        }
+    }
+    checks += 300020;
+
+    // threads sharing a sieve, each extending it while the others look numbers up
+    maxsum::PrimeSieve shared(300000);
+    vector<long long> wrong(4, 0);
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(thread([&shared, &sieve, &wrong, t]() {
+            for (int top = 100 + t; top < 300000; top = top * 2 - t) {
+                int cells[1] = {top};
+                shared.prepare(cells, 1);
+                for (int num = top / 2; num <= top; num++) {
+                    wrong[t] += shared.isPrime(num) != sieve.isPrime(num) ? 1 : 0;
+                }
+            }
+        }));
+    }
+    for (int t = 0; t < 4; t++) {
+        threads[t].join();
+        expect(wrong[t] == 0, "shared sieve, thread " + to_string(t), to_string(wrong[t]) + " wrong");
+    }
+
+    for (int k = 0; k < 300; k++) {
+        long long num = randomNumber(1000000000LL, 1000000000000LL);
+        expect(maxsum::isPrime(num) == trialPrime(num), "primality of " + to_string(num), "");
+    }
+
+    // strong pseudoprimes to several bases, Carmichael numbers, and primes near 2^32 and 2^63
+    const long long composites[] = {561, 41041, 825265, 4294967297LL, 4759123141LL, 3215031751LL, 2152302898747LL,
+                                    3474749660383LL, 341550071728321LL, 3825123056546413051LL,
+                                    998244359987710471LL, 9223372036854775807LL};
+    const long long primes[] = {2147483647LL, 4294967291LL, 999999000001LL, 999999999989LL,
+                                1000000000000000003LL, 2305843009213693951LL, 9223372036854775783LL};
+    for (size_t k = 0; k < sizeof(composites) / sizeof(composites[0]); k++) {
+        expect(maxsum::isPrime(composites[k]) == false, to_string(composites[k]) + " is not prime", "");
+    }
+    for (size_t k = 0; k < sizeof(primes) / sizeof(primes[0]); k++) {
+        expect(maxsum::isPrime(primes[k]) == true, to_string(primes[k]) + " is prime", "");
+    }
+}
+
+int main() {
+    for (int p = 0; p < 150; p++) {
+        int levels = (int) randomNumber(0, 9);
+        Rows rows = makeRows(levels, p % 5 == 0);
+        string text = toText(rows);
+        checkEngines(text, &rows, true, p % 5 == 0);
+        if (p % 5 != 0) {
+            checkTop(text, rows);
+        }
+    }
+    for (int p = 0; p < 30; p++) {
+        Rows rows = makeRows((int) randomNumber(20, 70), p % 5 == 0); // wider than a vector
+        checkEngines(toText(rows), NULL, true, p % 5 == 0);
+        checkEngines(malformedText((int) randomNumber(1, 12)), NULL, false, false);
+    }
+    checkEngines("4\n3000000000 9\n1 1 1\n", NULL, true, false); // every reader wraps it to 32-bit weights alike
+    checkLanes();
+    checkLevelPool(maxsum::MaxPlus<int>(), "auto");
+    checkLevelPool(maxsum::MaxPlus<int>(), "scalar");
+    checkLevelPool(maxsum::MaxPlus<long long>(), "auto");
+    checkLevelPool(maxsum::MinPlus<int>(), "auto");
+    maxsum::PrimeSieve sieve(1000);
+    checkUpdates(maxsum::MaxPlus<int>(), maxsum::NotPrime(&sieve), "not-prime");
+    checkUpdates(maxsum::MaxPlus<int>(), maxsum::ValueRange(-10, 50), "range:-10:50");
+    checkUpdates(maxsum::MinPlus<int>(), maxsum::ValueRange(-10, 50), "range:-10:50");
+    checkUpdates(maxsum::PathCount<int>(), maxsum::NotPrime(&sieve), "not-prime");
+    checkBatch();
+    checkTopologicalSort();
+    checkBlankTail();
+    checkLevelLimits();
+#if defined(__unix__) || defined(__APPLE__)
+    checkServer();
+    checkFifo();
+#endif
+    checkPrimes();
+    remove(checkFile);
+
+    cout << checks << " checks, " << failures << " failed." << endl;
+    return failures == 0 ? 0 : 1;
+}